@@ -259,6 +259,8 @@ void SocketIOclient::handleCbEvent(WStype_t type, uint8_t * payload, size_t leng
         case WStype_FRAGMENT_FIN:
         case WStype_PING:
         case WStype_PONG:
+        case WStype_TX_HIGH_WATER:
+        case WStype_TX_LOW_WATER:
             break;
     }
 }
\ No newline at end of file
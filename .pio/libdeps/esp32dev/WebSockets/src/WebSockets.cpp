@@ -59,6 +59,48 @@ extern "C" {
 
 #endif
 
+#ifdef WEBSOCKETS_TX_QUEUE_SOCKET
+#include <errno.h>
+#if defined(ESP32)
+#include <lwip/sockets.h>
+#else
+#include <sys/socket.h>
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+#include <new>
+
+typedef struct {
+    uint8_t serverMaxWindowBits;     ///< 0: not given
+    uint8_t clientMaxWindowBits;     ///< 0: not given, 15: given without a value
+    bool serverNoContextTakeover;
+    bool clientNoContextTakeover;
+} WSdeflateParams_t;
+#endif
+
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+// queue record: flags, length (uint16_t LE), frame bytes
+#define WS_TXQ_RECORD_HEADER (3)
+#define WS_TXQ_DROPPABLE (0x01)
+// bigger frames bypass the queue and are written as before
+#define WS_TXQ_FRAME_MAX (WEBSOCKETS_TX_QUEUE_SIZE - WS_TXQ_RECORD_HEADER)
+#endif
+
+WebSockets::~WebSockets(void) {
+    if(_txBuffer) {
+        free(_txBuffer);
+        _txBuffer = NULL;
+    }
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+    delete _deflate;
+    _deflate = NULL;
+#endif
+}
+
 /**
  *
  * @param client WSclient_t *  ptr to the client struct
@@ -77,6 +119,10 @@ void WebSockets::clientDisconnect(WSclient_t * client, uint16_t code, char * rea
             buffer[1] = (code & 0xFF);
             sendFrame(client, WSop_close, &buffer[0], 2);
         }
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+        // whatever the socket takes now, the rest is lost with the connection
+        txQueueFlush(client);
+#endif
     }
     clientDisconnect(client);
 }
@@ -166,6 +212,66 @@ uint8_t WebSockets::createHeader(uint8_t * headerPtr, WSopcode_t opcode, size_t
     return headerSize;
 }
 
+#if defined(__GNUC__)
+typedef uint32_t __attribute__((__may_alias__)) WSmaskWord_t;
+#else
+typedef uint32_t WSmaskWord_t;
+#endif
+
+/**
+ * XOR (un)mask a payload in place, 32 bit at a time
+ * byte loop until data is word aligned, then the key is rotated to match and whole words are processed
+ * @param data uint8_t *        ptr to the payload
+ * @param length size_t         length of the payload
+ * @param maskKey uint8_t *     4 byte mask key (no alignment needed)
+ * @param keyOffset size_t      position of data[0] in the whole payload (for data handled in parts)
+ */
+void WebSockets::maskPayload(uint8_t * data, size_t length, const uint8_t * maskKey, size_t keyOffset) {
+    uint8_t key[4];
+    for(uint8_t x = 0; x < 4; x++) {
+        key[x] = maskKey[(keyOffset + x) & 3];
+    }
+
+    // prologue
+    uint8_t k = 0;
+    while(length > 0 && ((uintptr_t)data & 3)) {
+        *data++ ^= key[k];
+        k = (k + 1) & 3;
+        length--;
+    }
+
+    if(length >= 4) {
+        // key bytes in memory order starting at k, memcpy keeps it endian independent
+        uint8_t rotated[4] = { key[k], key[(k + 1) & 3], key[(k + 2) & 3], key[(k + 3) & 3] };
+        uint32_t key32;
+        memcpy(&key32, rotated, 4);
+
+        WSmaskWord_t * word = (WSmaskWord_t *)data;
+        size_t words        = length / 4;
+        while(words >= 4) {
+            word[0] ^= key32;
+            word[1] ^= key32;
+            word[2] ^= key32;
+            word[3] ^= key32;
+            word += 4;
+            words -= 4;
+        }
+        while(words > 0) {
+            *word++ ^= key32;
+            words--;
+        }
+        data = (uint8_t *)word;
+        length &= 3;
+    }
+
+    // epilogue, a whole number of words was done so k still lines up
+    while(length > 0) {
+        *data++ ^= key[k];
+        k = (k + 1) & 3;
+        length--;
+    }
+}
+
 /**
  *
  * @param client WSclient_t *   ptr to the client struct
@@ -215,6 +321,21 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
         DEBUG_WEBSOCKETS("[WS][%d][sendFrame] text: %s\n", client->num, (payload + (headerToPayload ? 14 : 0)));
     }
 
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+    // whole messages only, fragments and control frames go out as they are
+    bool compressed = false;
+    if(client->cDeflate && fin && (opcode == WSop_text || opcode == WSop_binary) && length >= WEBSOCKETS_DEFLATE_MIN_SIZE) {
+        size_t packed = _deflate->compress(client->cDeflateTx, (headerToPayload ? (payload + WEBSOCKETS_MAX_HEADER_SIZE) : payload), length);
+        if(packed > 0) {
+            DEBUG_WEBSOCKETS("[WS][%d][sendFrame] deflate %u -> %u\n", client->num, length, packed);
+            payload         = _deflate->frame();
+            length          = packed;
+            headerToPayload = true;
+            compressed      = true;
+        }
+    }
+#endif
+
     uint8_t maskKey[4]                         = { 0x00, 0x00, 0x00, 0x00 };
     uint8_t buffer[WEBSOCKETS_MAX_HEADER_SIZE] = { 0 };
 
@@ -222,6 +343,7 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
     uint8_t * headerPtr;
     uint8_t * payloadPtr = payload;
     bool useInternBuffer = false;
+    bool freeBuffer      = false;
     bool ret             = true;
 
     // calculate header Size
@@ -237,13 +359,30 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
         headerSize += 4;
     }
 
+    if(headerToPayload && payload == _txBuffer) {
+        // committed tx buffer, we own the data and can mask in place
+        useInternBuffer = true;
+    }
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+    if(compressed) {
+        // so is the deflate frame buffer
+        useInternBuffer = true;
+    }
+#endif
+
 #ifdef WEBSOCKETS_USE_BIG_MEM
     // only for ESP since AVR has less HEAP
-    // try to send data in one TCP package (only if some free Heap is there)
-    if(!headerToPayload && ((length > 0) && (length < 1400)) && (GET_FREE_HEAP > 6000)) {
-        DEBUG_WEBSOCKETS("[WS][%d][sendFrame] pack to one TCP package...\n", client->num);
-        uint8_t * dataPtr = (uint8_t *)malloc(length + WEBSOCKETS_MAX_HEADER_SIZE);
+    // try to send data in one TCP package (reuse the tx buffer, fall back to the heap while it is leased)
+    if(!headerToPayload && ((length > 0) && (length <= WEBSOCKETS_TX_BUFFER_SIZE))) {
+        uint8_t * dataPtr = NULL;
+        if(!_txBufferLeased && allocTxBuffer()) {
+            dataPtr = _txBuffer;
+        } else if(GET_FREE_HEAP > 6000) {
+            dataPtr    = (uint8_t *)malloc(length + WEBSOCKETS_MAX_HEADER_SIZE);
+            freeBuffer = (dataPtr != NULL);
+        }
         if(dataPtr) {
+            DEBUG_WEBSOCKETS("[WS][%d][sendFrame] pack to one TCP package...\n", client->num);
             memcpy((dataPtr + WEBSOCKETS_MAX_HEADER_SIZE), payload, length);
             headerToPayload = true;
             useInternBuffer = true;
@@ -269,6 +408,11 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
     }
 
     createHeader(headerPtr, opcode, length, client->cIsClient, maskKey, fin);
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+    if(compressed) {
+        headerPtr[0] |= 0x40;    // RSV1: compressed message
+    }
+#endif
 
     if(client->cIsClient && useInternBuffer) {
         uint8_t * dataMaskPtr;
@@ -279,44 +423,111 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
             dataMaskPtr = payloadPtr;
         }
 
-        for(size_t x = 0; x < length; x++) {
-            dataMaskPtr[x] = (dataMaskPtr[x] ^ maskKey[x % 4]);
-        }
+        maskPayload(dataMaskPtr, length, maskKey);
     }
 
 #ifndef NODEBUG_WEBSOCKETS
     unsigned long start = micros();
 #endif
 
+    // only complete messages may be dropped, a lost fragment or control frame breaks the connection
+    bool droppable = fin && (opcode == WSop_text || opcode == WSop_binary);
+
     if(headerToPayload) {
         // header has be added to payload
         // payload is forced to reserved 14 Byte but we may not need all based on the length and mask settings
         // offset in payload is calculatetd 14 - headerSize
-        if(write(client, &payloadPtr[(WEBSOCKETS_MAX_HEADER_SIZE - headerSize)], (length + headerSize)) != (length + headerSize)) {
-            ret = false;
-        }
+        ret = writeFrame(client, &payloadPtr[(WEBSOCKETS_MAX_HEADER_SIZE - headerSize)], (length + headerSize), NULL, 0, droppable);
     } else {
-        // send header
-        if(write(client, &buffer[0], headerSize) != headerSize) {
-            ret = false;
-        }
-
-        if(payloadPtr && length > 0) {
-            // send payload
-            if(write(client, &payloadPtr[0], length) != length) {
-                ret = false;
-            }
-        }
+        ret = writeFrame(client, &buffer[0], headerSize, payloadPtr, (payloadPtr ? length : 0), droppable);
     }
 
     DEBUG_WEBSOCKETS("[WS][%d][sendFrame] sending Frame Done (%luus).\n", client->num, (micros() - start));
 
-#ifdef WEBSOCKETS_USE_BIG_MEM
-    if(useInternBuffer && payloadPtr) {
+    if(freeBuffer) {
         free(payloadPtr);
     }
+
+    return ret;
+}
+
+/**
+ * write one frame, given as header and payload (either may be empty)
+ * @param client WSclient_t *   ptr to the client struct
+ * @param head uint8_t *        frame header (or the whole frame)
+ * @param headLength size_t
+ * @param payload uint8_t *     rest of the frame
+ * @param length size_t
+ * @param droppable bool        the frame is a complete message the send queue may drop
+ * @return true if ok (sent or queued)
+ */
+bool WebSockets::writeFrame(WSclient_t * client, const uint8_t * head, size_t headLength, const uint8_t * payload, size_t length, bool droppable) {
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    if(headLength + length <= WS_TXQ_FRAME_MAX) {
+        return txQueueWrite(client, head, headLength, payload, length, droppable);
+    }
+#else
+    UNUSED(droppable);
 #endif
+    if(write(client, (uint8_t *)head, headLength) != headLength) {
+        return false;
+    }
+    if(length > 0 && write(client, (uint8_t *)payload, length) != length) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * allocate the reusable tx buffer (only once, kept for the lifetime of the object)
+ * @return true if the buffer is available
+ */
+bool WebSockets::allocTxBuffer(void) {
+    if(!_txBuffer) {
+        _txBuffer = (uint8_t *)malloc(WEBSOCKETS_MAX_HEADER_SIZE + WEBSOCKETS_TX_BUFFER_SIZE);
+        if(!_txBuffer) {
+            DEBUG_WEBSOCKETS("[WS][allocTxBuffer] to less memory for tx buffer!\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * hand out the payload area of the tx buffer so a message can be built in place.
+ * The buffer stays reserved for the caller until commitTxBuffer() is called.
+ * @param capacity size_t &     set to the usable payload size
+ * @return ptr to the payload area (WEBSOCKETS_MAX_HEADER_SIZE byte of headroom in front) or NULL
+ */
+uint8_t * WebSockets::leaseTxBuffer(size_t & capacity) {
+    capacity = 0;
+    if(_txBufferLeased || !allocTxBuffer()) {
+        return NULL;
+    }
+    _txBufferLeased = true;
+    capacity        = WEBSOCKETS_TX_BUFFER_SIZE;
+    return (_txBuffer + WEBSOCKETS_MAX_HEADER_SIZE);
+}
 
+/**
+ * send the payload written to the leased tx buffer, no copy and no heap allocation.
+ * The payload is masked in place for client connections, the lease is released in any case.
+ * A length of 0 only releases the lease (nothing is sent).
+ * @param client WSclient_t *   ptr to the client struct
+ * @param opcode WSopcode_t
+ * @param length size_t         length of the payload written after leaseTxBuffer()
+ * @param fin bool
+ * @return true if ok
+ */
+bool WebSockets::commitTxBuffer(WSclient_t * client, WSopcode_t opcode, size_t length, bool fin) {
+    if(!_txBufferLeased) {
+        return false;
+    }
+    bool ret = false;
+    if(length > 0 && length <= WEBSOCKETS_TX_BUFFER_SIZE) {
+        ret = sendFrame(client, opcode, _txBuffer, length, fin, true);
+    }
+    _txBufferLeased = false;
     return ret;
 }
 
@@ -339,6 +550,12 @@ void WebSockets::headerDone(WSclient_t * client) {
  * @param client WSclient_t *  ptr to the client struct
  */
 void WebSockets::handleWebsocket(WSclient_t * client) {
+#ifdef WEBSOCKETS_NONBLOCKING_READ
+    if(client->cRxReadPtr) {
+        readCbResume(client);
+        return;
+    }
+#endif
     if(client->cWsRXsize == 0) {
         handleWebsocketCb(client);
     }
@@ -364,19 +581,19 @@ bool WebSockets::handleWebsocketWaitFor(WSclient_t * client, size_t size) {
     }
 
     DEBUG_WEBSOCKETS("[WS][%d][handleWebsocketWaitFor] size: %d cWsRXsize: %d\n", client->num, size, client->cWsRXsize);
-    readCb(client, &client->cWsHeader[client->cWsRXsize], (size - client->cWsRXsize), std::bind([](WebSockets * server, size_t size, WSclient_t * client, bool ok) {
+    // continuations capture two words at most: std::function keeps them inline, no heap per read
+    readCb(client, &client->cWsHeader[client->cWsRXsize], (size - client->cWsRXsize), [this, size](WSclient_t * client, bool ok) {
         DEBUG_WEBSOCKETS("[WS][%d][handleWebsocketWaitFor][readCb] size: %d ok: %d\n", client->num, size, ok);
         if(ok) {
             client->cWsRXsize = size;
-            server->handleWebsocketCb(client);
+            handleWebsocketCb(client);
         } else {
             DEBUG_WEBSOCKETS("[WS][%d][readCb] failed.\n", client->num);
             client->cWsRXsize = 0;
             // timeout or error
-            server->clientDisconnect(client, 1002);
+            clientDisconnect(client, 1002);
         }
-    },
-                                                                                          this, size, std::placeholders::_1, std::placeholders::_2));
+    });
     return false;
 }
 
@@ -441,6 +658,22 @@ void WebSockets::handleWebsocketCb(WSclient_t * client) {
         return;
     }
 
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+    if(header->rsv1) {
+        if(!client->cDeflate || (header->opCode != WSop_text && header->opCode != WSop_binary)) {
+            DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] rsv1 without permessage-deflate!\n", client->num);
+            clientDisconnect(client, 1002);
+            return;
+        }
+        if(!header->fin) {
+            // compressed messages are inflated whole
+            DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] fragmented compressed message!\n", client->num);
+            clientDisconnect(client, 1009);
+            return;
+        }
+    }
+#endif
+
     if(header->mask) {
         headerLen += 4;
         if(!handleWebsocketWaitFor(client, headerLen)) {
@@ -451,15 +684,41 @@ void WebSockets::handleWebsocketCb(WSclient_t * client) {
     }
 
     if(header->payloadLen > 0) {
-        // if text data we need one more
-        payload = (uint8_t *)malloc(header->payloadLen + 1);
-
-        if(!payload) {
-            DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] to less memory to handle payload %d!\n", client->num, header->payloadLen);
-            clientDisconnect(client, 1011);
+#ifdef WEBSOCKETS_RX_ARENA_SIZE
+        if(header->payloadLen <= WEBSOCKETS_RX_ARENA_SIZE) {
+            payload = client->cRxArena;
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+        } else if(header->rsv1) {
+            // compressed messages are inflated whole, read into the heap below
+#endif
+        } else {
+            if(header->opCode & 0x08) {
+                DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] control frame too big! (%u)\n", client->num, header->payloadLen);
+                clientDisconnect(client, 1002);
+                return;
+            }
+            // stream it through the arena
+            client->cRxOffset = 0;
+            handleWebsocketChunk(client);
             return;
         }
-        readCb(client, payload, header->payloadLen, std::bind(&WebSockets::handleWebsocketPayloadCb, this, std::placeholders::_1, std::placeholders::_2, payload));
+#endif
+        if(!payload) {
+            // if text data we need one more
+            payload = (uint8_t *)malloc(header->payloadLen + 1);
+
+            if(!payload) {
+                DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] to less memory to handle payload %d!\n", client->num, header->payloadLen);
+                clientDisconnect(client, 1011);
+                return;
+            }
+#ifdef WEBSOCKETS_NONBLOCKING_READ
+            client->cRxPayload = payload;
+#endif
+        }
+        readCb(client, payload, header->payloadLen, [this, payload](WSclient_t * client, bool ok) {
+            handleWebsocketPayloadCb(client, ok, payload);
+        });
     } else {
         handleWebsocketPayloadCb(client, true, NULL);
     }
@@ -467,18 +726,36 @@ void WebSockets::handleWebsocketCb(WSclient_t * client) {
 
 void WebSockets::handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t * payload) {
     WSMessageHeader_t * header = &client->cWsHeaderDecode;
+#ifdef WEBSOCKETS_NONBLOCKING_READ
+    // freed here from now on
+    client->cRxPayload = nullptr;
+#endif
     if(ok) {
         if(header->payloadLen > 0) {
             payload[header->payloadLen] = 0x00;
 
             if(header->mask) {
                 // decode XOR
-                for(size_t i = 0; i < header->payloadLen; i++) {
-                    payload[i] = (payload[i] ^ header->maskKey[i % 4]);
-                }
+                maskPayload(payload, header->payloadLen, header->maskKey);
             }
         }
 
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+        uint8_t * inflated = NULL;
+        if(header->rsv1) {
+            size_t offset = 0;
+            size_t length = 0;
+            inflated      = _deflate->inflate(client->cDeflateRx, payload, header->payloadLen, offset, length);
+            freePayload(client, payload);
+            if(!inflated) {
+                clientDisconnect(client, 1007);
+                return;
+            }
+            payload            = &inflated[offset];
+            header->payloadLen = length;
+        }
+#endif
+
         switch(header->opCode) {
             case WSop_text:
                 DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] text: %s\n", client->num, payload);
@@ -519,9 +796,12 @@ void WebSockets::handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t
                 break;
         }
 
-        if(payload) {
-            free(payload);
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+        if(inflated) {
+            payload = inflated;
         }
+#endif
+        freePayload(client, payload);
 
         // reset input
         client->cWsRXsize = 0;
@@ -532,11 +812,97 @@ void WebSockets::handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t
 
     } else {
         DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] missing data!\n", client->num);
-        free(payload);
+        freePayload(client, payload);
         clientDisconnect(client, 1002);
     }
 }
 
+/**
+ * release a received payload: heap payloads are freed, the rx arena stays
+ * @param client WSclient_t *  ptr to the client struct
+ * @param payload uint8_t *
+ */
+void WebSockets::freePayload(WSclient_t * client, uint8_t * payload) {
+#ifdef WEBSOCKETS_RX_ARENA_SIZE
+    if(payload == client->cRxArena) {
+        return;
+    }
+#else
+    UNUSED(client);
+#endif
+    free(payload);
+}
+
+#ifdef WEBSOCKETS_RX_ARENA_SIZE
+/**
+ * read the next part of a payload that does not fit the rx arena
+ * parts are requested from the callback, the loop keeps the stack flat when readCb completes synchronously
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSockets::handleWebsocketChunk(WSclient_t * client) {
+    if(client->cRxReading) {
+        client->cRxPending = true;
+        return;
+    }
+
+    client->cRxReading = true;
+    do {
+        client->cRxPending = false;
+        size_t n           = client->cWsHeaderDecode.payloadLen - client->cRxOffset;
+        if(n > WEBSOCKETS_RX_ARENA_SIZE) {
+            n = WEBSOCKETS_RX_ARENA_SIZE;
+        }
+        readCb(client, client->cRxArena, n, [this, n](WSclient_t * client, bool ok) {
+            handleWebsocketChunkCb(client, ok, n);
+        });
+    } while(client->cRxPending);
+    client->cRxReading = false;
+}
+
+/**
+ * deliver one part of a streamed payload
+ * the first part keeps the frame opcode, the following parts are continuations and only the last one carries fin
+ * @param client WSclient_t *  ptr to the client struct
+ * @param ok bool
+ * @param length size_t        bytes in the arena
+ */
+void WebSockets::handleWebsocketChunkCb(WSclient_t * client, bool ok, size_t length) {
+    WSMessageHeader_t * header = &client->cWsHeaderDecode;
+    if(!ok) {
+        DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] missing data!\n", client->num);
+        clientDisconnect(client, 1002);
+        return;
+    }
+
+    uint8_t * payload = client->cRxArena;
+    if(header->mask) {
+        maskPayload(payload, length, header->maskKey, client->cRxOffset);
+    }
+    payload[length] = 0x00;
+
+    bool first = (client->cRxOffset == 0);
+    client->cRxOffset += length;
+    bool last = (client->cRxOffset >= header->payloadLen);
+
+    DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] part %u/%u\n", client->num, client->cRxOffset, header->payloadLen);
+    messageReceived(client, (first ? header->opCode : WSop_continuation), payload, length, (last && header->fin));
+
+    if(!last) {
+        if(clientIsConnected(client)) {
+            handleWebsocketChunk(client);
+        }
+        return;
+    }
+
+    // reset input
+    client->cWsRXsize = 0;
+#if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+    // register callback for next message
+    handleWebsocketWaitFor(client, 2);
+#endif
+}
+#endif
+
 /**
  * generate the key for Sec-WebSocket-Accept
  * @param clientKey String
@@ -606,6 +972,21 @@ bool WebSockets::readCb(WSclient_t * client, uint8_t * out, size_t n, WSreadWait
     },
                                        client, std::placeholders::_1, cb));
 
+#elif defined(WEBSOCKETS_NONBLOCKING_READ)
+    if(!client->tcp || !client->tcp->connected()) {
+        DEBUG_WEBSOCKETS("[readCb] not connected!\n");
+        if(cb) {
+            cb(client, false);
+        }
+        return false;
+    }
+
+    client->cRxReadPtr  = out;
+    client->cRxReadLeft = n;
+    client->cRxReadLast = millis();
+    client->cRxReadCb = std::move(cb);
+    return readCbResume(client);
+
 #else
     unsigned long t = millis();
     ssize_t len;
@@ -661,6 +1042,71 @@ bool WebSockets::readCb(WSclient_t * client, uint8_t * out, size_t n, WSreadWait
     return true;
 }
 
+#ifdef WEBSOCKETS_NONBLOCKING_READ
+/**
+ * continue the pending read with the data available now, never waits
+ * the callback is called once the read is complete or failed (disconnect, WEBSOCKETS_TCP_TIMEOUT without progress)
+ * @param client WSclient_t *  ptr to the client struct
+ * @return true if the read is done
+ */
+bool WebSockets::readCbResume(WSclient_t * client) {
+    if(!client->cRxReadPtr) {
+        return true;
+    }
+
+    bool ok = true;
+    if(!client->tcp || !client->tcp->connected()) {
+        DEBUG_WEBSOCKETS("[readCbResume] not connected!\n");
+        ok = false;
+    } else {
+        int available;
+        while(client->cRxReadLeft > 0 && (available = client->tcp->available()) > 0) {
+            int len = client->tcp->read(client->cRxReadPtr, std::min((size_t)available, client->cRxReadLeft));
+            if(len <= 0) {
+                break;
+            }
+            client->cRxReadPtr += len;
+            client->cRxReadLeft -= len;
+            client->cRxReadLast = millis();
+        }
+
+        if(client->cRxReadLeft > 0) {
+            if((millis() - client->cRxReadLast) <= WEBSOCKETS_TCP_TIMEOUT) {
+                // come back on the next loop
+                return false;
+            }
+            DEBUG_WEBSOCKETS("[readCbResume] receive TIMEOUT! %lu\n", (millis() - client->cRxReadLast));
+            ok = false;
+        }
+    }
+
+    // the callback may start the next read, take it out first (swap, no copy)
+    WSreadWaitCb cb;
+    cb.swap(client->cRxReadCb);
+    client->cRxReadPtr  = nullptr;
+    client->cRxReadLeft = 0;
+    if(cb) {
+        cb(client, ok);
+    }
+    return ok;
+}
+
+/**
+ * drop a pending read without calling its callback (connection is gone)
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSockets::readCbAbort(WSclient_t * client) {
+    client->cRxReadPtr  = nullptr;
+    client->cRxReadLeft = 0;
+    client->cRxReadCb   = nullptr;
+    if(client->cRxPayload) {
+        free(client->cRxPayload);
+        client->cRxPayload = nullptr;
+    }
+    client->cWsRXsize = 0;
+}
+#endif
+
 /**
  * write x byte to tcp or get timeout
  * @param client WSclient_t *
@@ -673,6 +1119,16 @@ size_t WebSockets::write(WSclient_t * client, uint8_t * out, size_t n) {
         return 0;
     if(client == NULL)
         return 0;
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    // these bytes may not be dropped (handshake, frames written in parts):
+    // queue them behind what is waiting, or wait until the queue is out and write them as before
+    if(n <= WS_TXQ_FRAME_MAX && txQueueWrite(client, out, n, NULL, 0, false)) {
+        return n;
+    }
+    if(!txQueueDrain(client)) {
+        return 0;
+    }
+#endif
     unsigned long t = millis();
     size_t len      = 0;
     size_t total    = 0;
@@ -719,6 +1175,402 @@ size_t WebSockets::write(WSclient_t * client, const char * out) {
     return write(client, (uint8_t *)out, strlen(out));
 }
 
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+/**
+ * write what the socket takes right now, never waits (see WEBSOCKETS_TX_QUEUE_SOCKET)
+ * @param client WSclient_t *
+ * @param out  uint8_t * data buffer
+ * @param n size_t byte count
+ * @return bytes written, -1 if the connection failed
+ */
+int WebSockets::writeNow(WSclient_t * client, const uint8_t * out, size_t n) {
+    if(!client->tcp || !client->tcp->connected()) {
+        return -1;
+    }
+    if(n == 0) {
+        return 0;
+    }
+#ifdef WEBSOCKETS_TX_QUEUE_SOCKET
+#if defined(HAS_SSL)
+    if(!client->isSSL)
+#endif
+    {
+        int len = ::send(client->tcp->fd(), out, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if(len >= 0) {
+            return len;
+        }
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+        DEBUG_WEBSOCKETS("[WS][%d][writeNow] send failed: %d\n", client->num, errno);
+        return -1;
+    }
+#endif
+    return client->tcp->write(out, n);
+}
+
+/**
+ * send a frame without waiting: written as far as the socket takes it, the rest is queued.
+ * A full queue is made room in by dropping queued messages (see WStxPolicy_t),
+ * without enough room a droppable frame is dropped itself.
+ * @param client WSclient_t *
+ * @param head uint8_t *        frame header (or the whole frame)
+ * @param headLength size_t
+ * @param payload uint8_t *     rest of the frame
+ * @param length size_t
+ * @param droppable bool        the frame is a complete message and may be dropped
+ * @return true if sent or queued
+ */
+bool WebSockets::txQueueWrite(WSclient_t * client, const uint8_t * head, size_t headLength, const uint8_t * payload, size_t length, bool droppable) {
+    size_t total = headLength + length;
+    size_t skip  = 0;
+
+    // older frames first
+    if(txQueueFlush(client)) {
+        int len = writeNow(client, head, headLength);
+        if(len == (int)headLength && length > 0) {
+            int more = writeNow(client, payload, length);
+            len      = (more < 0) ? more : (len + more);
+        }
+        if(len < 0) {
+            return false;
+        }
+        if((size_t)len == total) {
+            return true;
+        }
+        // started frames have to go out completely
+        skip      = len;
+        droppable = false;
+    }
+
+    size_t need = WS_TXQ_RECORD_HEADER + total - skip;
+    if(WEBSOCKETS_TX_QUEUE_SIZE - client->cTxQueued < need) {
+        bool all = droppable && (_txPolicy == WStx_keepLatest);
+        while(WEBSOCKETS_TX_QUEUE_SIZE - client->cTxQueued < need && txQueueDrop(client, all)) {
+        }
+        if(WEBSOCKETS_TX_QUEUE_SIZE - client->cTxQueued < need) {
+            DEBUG_WEBSOCKETS("[WS][%d][txQueueWrite] queue full, %u Byte not sent\n", client->num, total);
+            if(droppable) {
+                client->cTxDropped++;
+            }
+            return false;
+        }
+    }
+
+    uint8_t * record = &client->cTxQueue[client->cTxQueued];
+    record[0]        = droppable ? WS_TXQ_DROPPABLE : 0;
+    record[1]        = (total - skip) & 0xFF;
+    record[2]        = ((total - skip) >> 8) & 0xFF;
+    record += WS_TXQ_RECORD_HEADER;
+    if(skip < headLength) {
+        memcpy(record, head + skip, headLength - skip);
+        record += headLength - skip;
+        skip = 0;
+    } else {
+        skip -= headLength;
+    }
+    if(length > skip) {
+        memcpy(record, payload + skip, length - skip);
+    }
+    client->cTxQueued += need;
+
+    if(!client->cTxHigh && client->cTxQueued > WEBSOCKETS_TX_QUEUE_HIGH) {
+        client->cTxHigh = true;
+        txQueueEvent(client, WStype_TX_HIGH_WATER, client->cTxQueued);
+    }
+    return true;
+}
+
+/**
+ * send queued frames as far as the socket takes them, never waits
+ * @param client WSclient_t *
+ * @return true if the queue is empty
+ */
+bool WebSockets::txQueueFlush(WSclient_t * client) {
+    while(client->cTxQueued > 0) {
+        uint8_t * record = &client->cTxQueue[0];
+        size_t size      = record[1] | (record[2] << 8);
+        int len          = writeNow(client, record + WS_TXQ_RECORD_HEADER + client->cTxSent, size - client->cTxSent);
+        if(len <= 0) {
+            // socket full, or gone (loop() notices)
+            break;
+        }
+        client->cTxSent += len;
+        if(client->cTxSent < size) {
+            record[0] &= ~WS_TXQ_DROPPABLE;
+            break;
+        }
+        size += WS_TXQ_RECORD_HEADER;
+        client->cTxQueued -= size;
+        client->cTxSent = 0;
+        memmove(record, record + size, client->cTxQueued);
+    }
+
+    if(client->cTxHigh && client->cTxQueued < WEBSOCKETS_TX_QUEUE_LOW) {
+        client->cTxHigh = false;
+        txQueueEvent(client, WStype_TX_LOW_WATER, client->cTxQueued);
+    }
+    return (client->cTxQueued == 0);
+}
+
+/**
+ * wait until the queue is sent, like write() waits for the socket
+ * @param client WSclient_t *
+ * @return true if the queue is empty
+ */
+bool WebSockets::txQueueDrain(WSclient_t * client) {
+    unsigned long t = millis();
+    size_t queued   = client->cTxQueued;
+    while(!txQueueFlush(client)) {
+        if(!client->tcp || !client->tcp->connected()) {
+            return false;
+        }
+        if(client->cTxQueued != queued) {
+            queued = client->cTxQueued;
+            t      = millis();
+        } else if((millis() - t) > WEBSOCKETS_TCP_TIMEOUT) {
+            DEBUG_WEBSOCKETS("[WS][%d][txQueueDrain] TIMEOUT! %lu\n", client->num, (millis() - t));
+            return false;
+        }
+        WEBSOCKETS_YIELD();
+    }
+    return true;
+}
+
+/**
+ * drop queued messages, the oldest first
+ * @param client WSclient_t *
+ * @param all bool  all droppable ones, else only one
+ * @return true if something was dropped
+ */
+bool WebSockets::txQueueDrop(WSclient_t * client, bool all) {
+    bool dropped  = false;
+    size_t offset = 0;
+    while(offset < client->cTxQueued) {
+        uint8_t * record = &client->cTxQueue[offset];
+        size_t size      = WS_TXQ_RECORD_HEADER + (record[1] | (record[2] << 8));
+        if(!(record[0] & WS_TXQ_DROPPABLE)) {
+            offset += size;
+            continue;
+        }
+        client->cTxQueued -= size;
+        memmove(record, record + size, client->cTxQueued - offset);
+        client->cTxDropped++;
+        dropped = true;
+        if(!all) {
+            break;
+        }
+    }
+    return dropped;
+}
+
+/**
+ * forget the queue (connection is gone)
+ * @param client WSclient_t *
+ */
+void WebSockets::txQueueReset(WSclient_t * client) {
+    client->cTxQueued = 0;
+    client->cTxSent   = 0;
+    client->cTxHigh   = false;
+}
+#endif
+
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+/**
+ * parse one entry of a Sec-WebSocket-Extensions list
+ * @param entry String  "permessage-deflate; client_max_window_bits=10"
+ * @param params WSdeflateParams_t &
+ * @return 1: permessage-deflate, 0: permessage-deflate with invalid parameters, -1: other extension
+ */
+static int parseDeflateParams(const String & entry, WSdeflateParams_t & params) {
+    memset(&params, 0, sizeof(params));
+
+    bool first = true;
+    int start  = 0;
+    while(start <= (int)entry.length()) {
+        int end = entry.indexOf(';', start);
+        if(end < 0) {
+            end = entry.length();
+        }
+        String param = entry.substring(start, end);
+        param.trim();
+        start = end + 1;
+
+        if(first) {
+            if(!param.equalsIgnoreCase(WEBSOCKETS_STRING("permessage-deflate"))) {
+                return -1;
+            }
+            first = false;
+            continue;
+        }
+
+        String value;
+        int eq = param.indexOf('=');
+        if(eq >= 0) {
+            value = param.substring(eq + 1);
+            param.remove(eq);
+            param.trim();
+            value.trim();
+            // quoted-string (RFC 7692 7.1)
+            if(value.length() >= 2 && value[0] == '"' && value[value.length() - 1] == '"') {
+                value = value.substring(1, value.length() - 1);
+            }
+        }
+        int bits = value.toInt();
+
+        if(param.equalsIgnoreCase(WEBSOCKETS_STRING("server_no_context_takeover")) && eq < 0 && !params.serverNoContextTakeover) {
+            params.serverNoContextTakeover = true;
+        } else if(param.equalsIgnoreCase(WEBSOCKETS_STRING("client_no_context_takeover")) && eq < 0 && !params.clientNoContextTakeover) {
+            params.clientNoContextTakeover = true;
+        } else if(param.equalsIgnoreCase(WEBSOCKETS_STRING("server_max_window_bits")) && bits >= 8 && bits <= 15 && !params.serverMaxWindowBits) {
+            params.serverMaxWindowBits = bits;
+        } else if(param.equalsIgnoreCase(WEBSOCKETS_STRING("client_max_window_bits")) && (eq < 0 || (bits >= 8 && bits <= 15)) && !params.clientMaxWindowBits) {
+            params.clientMaxWindowBits = (eq < 0) ? 15 : bits;
+        } else {
+            DEBUG_WEBSOCKETS("[WS][deflate] invalid parameter: %s\n", param.c_str());
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * client: check the server's answer to our offer (cExtensions) and set the connection up
+ * @param client WSclient_t *  ptr to the client struct
+ * @return false if the answer can not be accepted (fail the connection)
+ */
+bool WebSockets::deflateAccept(WSclient_t * client) {
+    WSdeflateParams_t params;
+    int start = 0;
+    while(start <= (int)client->cExtensions.length()) {
+        int end = client->cExtensions.indexOf(',', start);
+        if(end < 0) {
+            end = client->cExtensions.length();
+        }
+        int found = parseDeflateParams(client->cExtensions.substring(start, end), params);
+        start     = end + 1;
+        if(found < 0) {
+            continue;
+        }
+
+        // we asked for a window of WEBSOCKETS_DEFLATE_WINDOW_BITS, the server has to confirm it
+        if(found == 0 || params.serverMaxWindowBits == 0 || params.serverMaxWindowBits > WEBSOCKETS_DEFLATE_WINDOW_BITS || params.clientMaxWindowBits > WEBSOCKETS_DEFLATE_WINDOW_BITS) {
+            DEBUG_WEBSOCKETS("[WS][deflate] answer not acceptable: %s\n", client->cExtensions.c_str());
+            return false;
+        }
+        uint8_t txBits = params.clientMaxWindowBits ? params.clientMaxWindowBits : WEBSOCKETS_DEFLATE_WINDOW_BITS;
+        return deflateSetup(client, txBits, !params.clientNoContextTakeover, params.serverMaxWindowBits, !params.serverNoContextTakeover);
+    }
+    return true;
+}
+
+/**
+ * server: accept the first usable permessage-deflate offer (cExtensions) and set the connection up
+ * @param client WSclient_t *  ptr to the client struct
+ * @return Sec-WebSocket-Extensions answer, empty if nothing was accepted
+ */
+String WebSockets::deflateAnswer(WSclient_t * client) {
+    WSdeflateParams_t params;
+    int start = 0;
+    while(start <= (int)client->cExtensions.length()) {
+        int end = client->cExtensions.indexOf(',', start);
+        if(end < 0) {
+            end = client->cExtensions.length();
+        }
+        int found = parseDeflateParams(client->cExtensions.substring(start, end), params);
+        start     = end + 1;
+        if(found <= 0) {
+            continue;
+        }
+
+        uint8_t txBits = WEBSOCKETS_DEFLATE_WINDOW_BITS;
+        if(params.serverMaxWindowBits && params.serverMaxWindowBits < txBits) {
+            txBits = params.serverMaxWindowBits;
+        }
+        // a client that can not limit its window starts every message anew
+        bool rxTakeover = params.clientMaxWindowBits && !params.clientNoContextTakeover;
+        uint8_t rxBits  = (params.clientMaxWindowBits && params.clientMaxWindowBits < WEBSOCKETS_DEFLATE_WINDOW_BITS) ? params.clientMaxWindowBits : WEBSOCKETS_DEFLATE_WINDOW_BITS;
+
+        if(!deflateSetup(client, txBits, !params.serverNoContextTakeover, rxBits, rxTakeover)) {
+            return String();
+        }
+
+        String answer = WEBSOCKETS_STRING("permessage-deflate");
+        if(params.serverNoContextTakeover) {
+            answer += WEBSOCKETS_STRING("; server_no_context_takeover");
+        }
+        if(params.serverMaxWindowBits) {
+            answer += WEBSOCKETS_STRING("; server_max_window_bits=");
+            answer += String(txBits);
+        }
+        if(rxTakeover) {
+            answer += WEBSOCKETS_STRING("; client_max_window_bits=");
+            answer += String(rxBits);
+        } else {
+            answer += WEBSOCKETS_STRING("; client_no_context_takeover");
+        }
+        return answer;
+    }
+    return String();
+}
+
+/**
+ * allocate the windows of a connection (and the codec on first use)
+ * @param client WSclient_t *  ptr to the client struct
+ * @param txBits uint8_t      max_window_bits we compress with
+ * @param txTakeover bool     keep our context between messages
+ * @param rxBits uint8_t      max_window_bits the peer compresses with
+ * @param rxTakeover bool     the peer keeps its context between messages
+ * @return true if ok
+ */
+bool WebSockets::deflateSetup(WSclient_t * client, uint8_t txBits, bool txTakeover, uint8_t rxBits, bool rxTakeover) {
+    deflateReset(client);
+
+    if(!_deflate) {
+        _deflate = new(std::nothrow) WebSocketsDeflate;
+        if(!_deflate) {
+            DEBUG_WEBSOCKETS("[WS][%d][deflate] no memory for the codec!\n", client->num);
+            return false;
+        }
+    }
+
+    client->cDeflateTx.bits = txBits;
+    client->cDeflateTx.size = 1 << txBits;
+    if(txTakeover) {
+        // without it every message just starts anew
+        client->cDeflateTx.window = (uint8_t *)malloc(client->cDeflateTx.size);
+    }
+
+    // zlib compresses with 9 bits when asked for 8
+    client->cDeflateRx.bits = rxBits;
+    client->cDeflateRx.size = 1 << (rxBits < 9 ? 9 : rxBits);
+    if(rxTakeover) {
+        client->cDeflateRx.window = (uint8_t *)malloc(client->cDeflateRx.size);
+        if(!client->cDeflateRx.window) {
+            DEBUG_WEBSOCKETS("[WS][%d][deflate] no memory for the window!\n", client->num);
+            deflateReset(client);
+            return false;
+        }
+    }
+
+    DEBUG_WEBSOCKETS("[WS][%d][deflate] tx %u bits%s, rx %u bits%s\n", client->num, txBits, client->cDeflateTx.window ? "" : " no context", rxBits, rxTakeover ? "" : " no context");
+    client->cDeflate = true;
+    return true;
+}
+
+/**
+ * free the windows of a connection
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSockets::deflateReset(WSclient_t * client) {
+    free(client->cDeflateTx.window);
+    free(client->cDeflateRx.window);
+    client->cDeflateTx = WSdeflateWindow_t();
+    client->cDeflateRx = WSdeflateWindow_t();
+    client->cDeflate   = false;
+}
+#endif
+
 /**
  * enable ping/pong heartbeat process
  * @param client WSclient_t *
@@ -77,6 +77,15 @@
 #define WEBSOCKETS_YIELD_MORE() delay(1)
 #endif
 
+#elif defined(WEBSOCKETS_NATIVE)
+
+// host build (tests / benchmarks), sized like the ESP32 so the same code paths run
+#define WEBSOCKETS_MAX_DATA_SIZE (15 * 1024)
+#define WEBSOCKETS_USE_BIG_MEM
+#define GET_FREE_HEAP (256 * 1024)
+#define WEBSOCKETS_YIELD() yield()
+#define WEBSOCKETS_YIELD_MORE() delay(1)
+
 #elif defined(STM32_DEVICE)
 
 #define WEBSOCKETS_MAX_DATA_SIZE (15 * 1024)
@@ -140,6 +149,59 @@
 // max size of the WS Message Header
 #define WEBSOCKETS_MAX_HEADER_SIZE (14)
 
+// payload capacity of the reusable send buffer (allocated once on first use,
+// WEBSOCKETS_MAX_HEADER_SIZE byte of header headroom are added in front)
+#ifndef WEBSOCKETS_TX_BUFFER_SIZE
+#define WEBSOCKETS_TX_BUFFER_SIZE (1400)
+#endif
+
+// optional fixed receive buffer per client, no malloc for incoming payloads.
+// payloads bigger than the buffer are delivered in parts as WStype_FRAGMENT_* events
+// (text parts may end inside a UTF-8 sequence)
+// #define WEBSOCKETS_RX_ARENA_SIZE (512)
+#if defined(WEBSOCKETS_RX_ARENA_SIZE) && (WEBSOCKETS_RX_ARENA_SIZE < 125)
+#error "WEBSOCKETS_RX_ARENA_SIZE must hold a full control frame (125 Byte)"
+#endif
+
+// resumable frame reader: readCb() takes what is available and returns, the read
+// continues on the next loop() instead of polling the socket for up to WEBSOCKETS_TCP_TIMEOUT
+// #define WEBSOCKETS_NONBLOCKING_READ
+
+// optional send queue per client (Byte): a frame goes out as far as the socket takes it
+// right now, the rest is queued and sent from loop() instead of waiting up to
+// WEBSOCKETS_TCP_TIMEOUT for a slow peer. See WStxPolicy_t for a full queue.
+// #define WEBSOCKETS_TX_QUEUE_SIZE (4096)
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+#if (WEBSOCKETS_TX_QUEUE_SIZE < 256) || (WEBSOCKETS_TX_QUEUE_SIZE > 0xFFFF)
+#error "WEBSOCKETS_TX_QUEUE_SIZE must be 256 - 65535 Byte"
+#endif
+// WStype_TX_HIGH_WATER once more is queued, WStype_TX_LOW_WATER when it drained below WEBSOCKETS_TX_QUEUE_LOW
+#ifndef WEBSOCKETS_TX_QUEUE_HIGH
+#define WEBSOCKETS_TX_QUEUE_HIGH (WEBSOCKETS_TX_QUEUE_SIZE * 3 / 4)
+#endif
+#ifndef WEBSOCKETS_TX_QUEUE_LOW
+#define WEBSOCKETS_TX_QUEUE_LOW (WEBSOCKETS_TX_QUEUE_SIZE / 4)
+#endif
+#endif
+
+// permessage-deflate (RFC 7692): the client offers it, the server accepts it.
+// Windows of 1 << bits Byte per direction and connection keep the context between
+// messages, the peer is asked to stay within them. The codec shared by all
+// connections takes ~3 windows + 5.5 KB.
+// #define WEBSOCKETS_DEFLATE_WINDOW_BITS (10)
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+#if (WEBSOCKETS_DEFLATE_WINDOW_BITS < 9) || (WEBSOCKETS_DEFLATE_WINDOW_BITS > 15)
+#error "WEBSOCKETS_DEFLATE_WINDOW_BITS must be 9 - 15 (zlib does not compress with 8)"
+#endif
+// shorter messages are sent as they are
+#ifndef WEBSOCKETS_DEFLATE_MIN_SIZE
+#define WEBSOCKETS_DEFLATE_MIN_SIZE (32)
+#endif
+#define WEBSOCKETS_DEFLATE_BITS_STR(bits) #bits
+#define WEBSOCKETS_DEFLATE_BITS(bits) WEBSOCKETS_DEFLATE_BITS_STR(bits)
+#define WEBSOCKETS_DEFLATE_OFFER "permessage-deflate; client_max_window_bits=" WEBSOCKETS_DEFLATE_BITS(WEBSOCKETS_DEFLATE_WINDOW_BITS) "; server_max_window_bits=" WEBSOCKETS_DEFLATE_BITS(WEBSOCKETS_DEFLATE_WINDOW_BITS)
+#endif
+
 #if !defined(WEBSOCKETS_NETWORK_TYPE)
 // select Network type based
 #if defined(ESP8266) || defined(ESP31B)
@@ -163,6 +225,9 @@
 #elif defined(WIO_TERMINAL) || defined(SEEED_XIAO_M0)
 #define WEBSOCKETS_NETWORK_TYPE NETWORK_SAMD_SEED
 
+#elif defined(WEBSOCKETS_NATIVE)
+#define WEBSOCKETS_NETWORK_TYPE NETWORK_CUSTOM
+
 #else
 #define WEBSOCKETS_NETWORK_TYPE NETWORK_W5100
 
@@ -288,12 +353,17 @@
 #define WEBSOCKETS_NETWORK_SERVER_CLASS WiFiServer
 
 #elif (WEBSOCKETS_NETWORK_TYPE == NETWORK_CUSTOM)
+#if defined(WEBSOCKETS_NATIVE)
+// no TLS on the host
+#include <WebSocketsNetworkClient.h>
+#else
 #include <WebSocketsNetworkClientSecure.h>
+#define SSL_AXTLS
+#define WEBSOCKETS_NETWORK_SSL_CLASS WebSocketsNetworkClientSecure
+#endif
 #include <WiFiServer.h>
 
-#define SSL_AXTLS
 #define WEBSOCKETS_NETWORK_CLASS WebSocketsNetworkClient
-#define WEBSOCKETS_NETWORK_SSL_CLASS WebSocketsNetworkClientSecure
 #define WEBSOCKETS_NETWORK_SERVER_CLASS WiFiServer
 #else
 #error "no network type selected!"
@@ -303,6 +373,19 @@
 #define HAS_SSL
 #endif
 
+#if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+// reads are event driven already
+#undef WEBSOCKETS_NONBLOCKING_READ
+// AsyncTCPbuffer queues itself
+#undef WEBSOCKETS_TX_QUEUE_SIZE
+#endif
+
+#if defined(WEBSOCKETS_TX_QUEUE_SIZE) && ((WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32_ETH) || defined(WEBSOCKETS_NATIVE))
+// the network class exposes its socket (fd()), the queue writes to it with MSG_DONTWAIT.
+// Elsewhere it uses tcp->write(), which may still wait if the network class does.
+#define WEBSOCKETS_TX_QUEUE_SOCKET
+#endif
+
 // moves all Header strings to Flash (~300 Byte)
 #ifdef WEBSOCKETS_SAVE_RAM
 #define WEBSOCKETS_STRING(var) F(var)
@@ -310,6 +393,10 @@
 #define WEBSOCKETS_STRING(var) var
 #endif
 
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+#include "WebSocketsDeflate.h"
+#endif
+
 typedef enum {
     WSC_NOT_CONNECTED,
     WSC_HEADER,
@@ -329,8 +416,15 @@ typedef enum {
     WStype_FRAGMENT_FIN,
     WStype_PING,
     WStype_PONG,
+    WStype_TX_HIGH_WATER,    ///< send queue above WEBSOCKETS_TX_QUEUE_HIGH, length: queued Byte
+    WStype_TX_LOW_WATER,     ///< send queue back below WEBSOCKETS_TX_QUEUE_LOW, length: queued Byte
 } WStype_t;
 
+typedef enum {
+    WStx_dropOldest,    ///< queue full: drop the oldest queued messages until the new one fits
+    WStx_keepLatest,    ///< queue full: drop all queued messages, the new one is the latest state
+} WStxPolicy_t;
+
 typedef enum {
     WSop_continuation = 0x00,    ///< %x0 denotes a continuation frame
     WSop_text         = 0x01,    ///< %x1 denotes a text frame
@@ -356,7 +450,7 @@ typedef struct {
     uint8_t * maskKey;
 } WSMessageHeader_t;
 
-typedef struct {
+typedef struct WSclient_s {
     void init(uint8_t num,
         uint32_t pingInterval,
         uint32_t pongTimeout,
@@ -398,6 +492,35 @@ typedef struct {
     uint8_t cWsHeader[WEBSOCKETS_MAX_HEADER_SIZE];    ///< RX WS Message buffer
     WSMessageHeader_t cWsHeaderDecode;
 
+#ifdef WEBSOCKETS_RX_ARENA_SIZE
+    uint8_t cRxArena[WEBSOCKETS_RX_ARENA_SIZE + 1];    ///< RX payload buffer (+1 for the text terminator)
+    size_t cRxOffset = 0;                              ///< payload bytes already delivered
+    bool cRxReading  = false;                          ///< part read loop is running
+    bool cRxPending  = false;                          ///< next part requested from inside the loop
+#endif
+
+#ifdef WEBSOCKETS_NONBLOCKING_READ
+    uint8_t * cRxReadPtr      = nullptr;    ///< destination of the pending read (nullptr if none)
+    size_t cRxReadLeft        = 0;          ///< bytes the pending read still needs
+    unsigned long cRxReadLast = 0;          ///< millis of the last progress
+    std::function<void(struct WSclient_s * client, bool ok)> cRxReadCb;    ///< continuation of the pending read (WSreadWaitCb)
+    uint8_t * cRxPayload = nullptr;            ///< heap payload owned by the pending read
+#endif
+
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    uint8_t cTxQueue[WEBSOCKETS_TX_QUEUE_SIZE];    ///< frames the socket did not take yet, each behind a 3 Byte record header
+    size_t cTxQueued    = 0;                       ///< Byte used in cTxQueue
+    size_t cTxSent      = 0;                       ///< Byte of the first frame already written
+    bool cTxHigh        = false;                   ///< WStype_TX_HIGH_WATER sent, waiting for the low watermark
+    uint32_t cTxDropped = 0;                       ///< messages dropped by the queue policy
+#endif
+
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+    bool cDeflate = false;           ///< permessage-deflate negotiated
+    WSdeflateWindow_t cDeflateTx;    ///< what we compressed so far
+    WSdeflateWindow_t cDeflateRx;    ///< what the peer compressed so far
+#endif
+
     String base64Authorization;    ///< Base64 encoded Auth request
     String plainAuthorization;     ///< Base64 encoded Auth request
 
@@ -427,16 +550,36 @@ class WebSockets {
     typedef std::function<void(WSclient_t * client, bool ok)> WSreadWaitCb;
 #endif
 
+    ~WebSockets(void);
+
+    uint8_t * _txBuffer  = NULL;     ///< reusable frame buffer: header headroom + payload
+    bool _txBufferLeased = false;    ///< payload area handed out by leaseTxBuffer() and not yet committed
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    WStxPolicy_t _txPolicy = WStx_dropOldest;
+#endif
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+    WebSocketsDeflate * _deflate = NULL;    ///< codec for all clients, allocated on the first negotiation
+#endif
+
     virtual void clientDisconnect(WSclient_t * client)  = 0;
     virtual bool clientIsConnected(WSclient_t * client) = 0;
 
     void clientDisconnect(WSclient_t * client, uint16_t code, char * reason = NULL, size_t reasonLen = 0);
 
     virtual void messageReceived(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin) = 0;
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    virtual void txQueueEvent(WSclient_t * client, WStype_t type, size_t queued) = 0;
+#endif
 
     uint8_t createHeader(uint8_t * buf, WSopcode_t opcode, size_t length, bool mask, uint8_t maskKey[4], bool fin);
+    static void maskPayload(uint8_t * data, size_t length, const uint8_t * maskKey, size_t keyOffset = 0);
     bool sendFrameHeader(WSclient_t * client, WSopcode_t opcode, size_t length = 0, bool fin = true);
     bool sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * payload = NULL, size_t length = 0, bool fin = true, bool headerToPayload = false);
+    bool writeFrame(WSclient_t * client, const uint8_t * head, size_t headLength, const uint8_t * payload, size_t length, bool droppable);
+
+    bool allocTxBuffer(void);
+    uint8_t * leaseTxBuffer(size_t & capacity);
+    bool commitTxBuffer(WSclient_t * client, WSopcode_t opcode, size_t length, bool fin = true);
 
     void headerDone(WSclient_t * client);
 
@@ -445,14 +588,39 @@ class WebSockets {
     bool handleWebsocketWaitFor(WSclient_t * client, size_t size);
     void handleWebsocketCb(WSclient_t * client);
     void handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t * payload);
+    void freePayload(WSclient_t * client, uint8_t * payload);
+#ifdef WEBSOCKETS_RX_ARENA_SIZE
+    void handleWebsocketChunk(WSclient_t * client);
+    void handleWebsocketChunkCb(WSclient_t * client, bool ok, size_t length);
+#endif
 
     String acceptKey(String & clientKey);
     String base64_encode(uint8_t * data, size_t length);
 
     bool readCb(WSclient_t * client, uint8_t * out, size_t n, WSreadWaitCb cb);
+#ifdef WEBSOCKETS_NONBLOCKING_READ
+    bool readCbResume(WSclient_t * client);
+    void readCbAbort(WSclient_t * client);
+#endif
     virtual size_t write(WSclient_t * client, uint8_t * out, size_t n);
     size_t write(WSclient_t * client, const char * out);
 
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    int writeNow(WSclient_t * client, const uint8_t * out, size_t n);
+    bool txQueueWrite(WSclient_t * client, const uint8_t * head, size_t headLength, const uint8_t * payload, size_t length, bool droppable);
+    bool txQueueFlush(WSclient_t * client);
+    bool txQueueDrain(WSclient_t * client);
+    bool txQueueDrop(WSclient_t * client, bool all);
+    void txQueueReset(WSclient_t * client);
+#endif
+
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+    bool deflateAccept(WSclient_t * client);
+    String deflateAnswer(WSclient_t * client);
+    bool deflateSetup(WSclient_t * client, uint8_t txBits, bool txTakeover, uint8_t rxBits, bool rxTakeover);
+    void deflateReset(WSclient_t * client);
+#endif
+
     void enableHeartbeat(WSclient_t * client, uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount);
     void handleHBTimeout(WSclient_t * client);
 };
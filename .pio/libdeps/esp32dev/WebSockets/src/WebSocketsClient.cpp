@@ -33,6 +33,7 @@ WebSocketsClient::WebSocketsClient() {
     _reconnectInterval   = 500;
     _port                = 0;
     _host                = "";
+    _handshakeKey        = 0;
 }
 
 WebSocketsClient::~WebSocketsClient() {
@@ -43,8 +44,12 @@ WebSocketsClient::~WebSocketsClient() {
  * calles to init the Websockets server
  */
 void WebSocketsClient::begin(const char * host, uint16_t port, const char * url, const char * protocol) {
-    _host = host;
-    _port = port;
+    // begin() again, e.g. with a new address: clean up a failed attempt first
+    clientIsConnected(&_client);
+
+    _host      = host;
+    _port      = port;
+    _handshake = "";
 #if defined(HAS_SSL)
     _fingerprint = SSL_FINGERPRINT_NULL;
     _CA_cert     = NULL;
@@ -235,8 +240,8 @@ void WebSocketsClient::loop(void) {
     }
     WEBSOCKETS_YIELD();
     if(!clientIsConnected(&_client)) {
-        // do not flood the server
-        if((millis() - _lastConnectionFail) < _reconnectInterval) {
+        // do not flood the server, but connect at once after begin() and a successful connection
+        if(_lastConnectionFail && (millis() - _lastConnectionFail) < _reconnectInterval) {
             return;
         }
 
@@ -324,6 +329,9 @@ void WebSocketsClient::loop(void) {
             _lastConnectionFail = millis();
         }
     } else {
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+        txQueueFlush(&_client);
+#endif
         handleClientData();
         WEBSOCKETS_YIELD();
         if(_client.status == WSC_CONNECTED) {
@@ -401,6 +409,42 @@ bool WebSocketsClient::sendBIN(const uint8_t * payload, size_t length) {
     return sendBIN((uint8_t *)payload, length);
 }
 
+/**
+ * get the reusable tx buffer to build a message in place (no heap, no copy on send).
+ * Exactly one commitTXT() / commitBIN() must follow before the buffer can be requested again.
+ * @param capacity size_t &     set to the max payload length
+ * @return uint8_t * payload area or NULL
+ */
+uint8_t * WebSocketsClient::getTxBuffer(size_t & capacity) {
+    return leaseTxBuffer(capacity);
+}
+
+/**
+ * send the text written to the tx buffer
+ * @param length size_t
+ * @return true if ok
+ */
+bool WebSocketsClient::commitTXT(size_t length) {
+    if(!clientIsConnected(&_client)) {
+        _txBufferLeased = false;
+        return false;
+    }
+    return commitTxBuffer(&_client, WSop_text, length);
+}
+
+/**
+ * send the binary data written to the tx buffer
+ * @param length size_t
+ * @return true if ok
+ */
+bool WebSocketsClient::commitBIN(size_t length) {
+    if(!clientIsConnected(&_client)) {
+        _txBufferLeased = false;
+        return false;
+    }
+    return commitTxBuffer(&_client, WSop_binary, length);
+}
+
 /**
  * sends a WS ping to Server
  * @param payload uint8_t *
@@ -442,6 +486,7 @@ void WebSocketsClient::setAuthorization(const char * user, const char * password
         auth += ":";
         auth += password;
         _client.base64Authorization = base64_encode((uint8_t *)auth.c_str(), auth.length());
+        _handshake                  = "";
     }
 }
 
@@ -453,6 +498,7 @@ void WebSocketsClient::setAuthorization(const char * auth) {
     if(auth) {
         //_client.base64Authorization = auth;
         _client.plainAuthorization = auth;
+        _handshake                 = "";
     }
 }
 
@@ -463,6 +509,7 @@ void WebSocketsClient::setAuthorization(const char * auth) {
  */
 void WebSocketsClient::setExtraHeaders(const char * extraHeaders) {
     _client.extraHeaders = extraHeaders;
+    _handshake           = "";
 }
 
 /**
@@ -478,6 +525,30 @@ bool WebSocketsClient::isConnected(void) {
     return (_client.status == WSC_CONNECTED);
 }
 
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+/**
+ * what to drop when the send queue is full
+ * @param policy WStxPolicy_t
+ */
+void WebSocketsClient::setTxQueuePolicy(WStxPolicy_t policy) {
+    _txPolicy = policy;
+}
+
+/**
+ * @return Byte waiting in the send queue
+ */
+size_t WebSocketsClient::txQueued(void) {
+    return _client.cTxQueued;
+}
+
+/**
+ * @return messages dropped by the send queue policy
+ */
+uint32_t WebSocketsClient::txDropped(void) {
+    return _client.cTxDropped;
+}
+#endif
+
 // #################################################################################
 // #################################################################################
 // #################################################################################
@@ -518,6 +589,19 @@ void WebSocketsClient::messageReceived(WSclient_t * client, WSopcode_t opcode, u
     runCbEvent(type, payload, length);
 }
 
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+/**
+ * send queue crossed a watermark
+ * @param client WSclient_t *  ptr to the client struct
+ * @param type WStype_t        WStype_TX_HIGH_WATER or WStype_TX_LOW_WATER
+ * @param queued size_t        Byte in the queue
+ */
+void WebSocketsClient::txQueueEvent(WSclient_t * client, WStype_t type, size_t queued) {
+    UNUSED(client);
+    runCbEvent(type, NULL, queued);
+}
+#endif
+
 /**
  * Disconnect an client
  * @param client WSclient_t *  ptr to the client struct
@@ -566,9 +650,22 @@ void WebSocketsClient::clientDisconnect(WSclient_t * client) {
     client->cIsWebsocket = false;
     client->cSessionId   = "";
 
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+    // the server's answer, not to be sent as our offer next time
+    client->cExtensions = "";
+    deflateReset(client);
+#endif
+
     client->status      = WSC_NOT_CONNECTED;
     _lastConnectionFail = millis();
 
+#ifdef WEBSOCKETS_NONBLOCKING_READ
+    readCbAbort(client);
+#endif
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    txQueueReset(client);
+#endif
+
     DEBUG_WEBSOCKETS("[WS-Client] client disconnected.\n");
     if(event) {
         runCbEvent(WStype_DISCONNECTED, NULL, 0);
@@ -637,6 +734,11 @@ void WebSocketsClient::handleClientData(void) {
                 WebSockets::clientDisconnect(&_client, 1002);
                 break;
         }
+#ifdef WEBSOCKETS_NONBLOCKING_READ
+    } else if(_client.cRxReadPtr) {
+        // nothing new, only check the pending read for timeout
+        readCbResume(&_client);
+#endif
     }
     WEBSOCKETS_YIELD();
 }
@@ -647,8 +749,6 @@ void WebSocketsClient::handleClientData(void) {
  * @param client WSclient_t *  ptr to the client struct
  */
 void WebSocketsClient::sendHeader(WSclient_t * client) {
-    static const char * NEW_LINE = "\r\n";
-
     DEBUG_WEBSOCKETS("[WS-Client][sendHeader] sending header...\n");
 
     uint8_t randomKey[16] = { 0 };
@@ -663,7 +763,37 @@ void WebSocketsClient::sendHeader(WSclient_t * client) {
     unsigned long start = micros();
 #endif
 
-    String handshake;
+    // the request only changes with the key, except for the Socket.IO session
+    String socketIOHandshake;
+    String & handshake = client->isSocketIO ? socketIOHandshake : _handshake;
+    if(handshake.length() == 0) {
+        buildHeader(client, handshake);
+    }
+    if(_handshakeKey) {
+        for(unsigned int i = 0; i < client->cKey.length(); i++) {
+            handshake[_handshakeKey + i] = client->cKey[i];
+        }
+    }
+
+    DEBUG_WEBSOCKETS("[WS-Client][sendHeader] handshake %s", (uint8_t *)handshake.c_str());
+    write(client, (uint8_t *)handshake.c_str(), handshake.length());
+
+#if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+    client->tcp->readStringUntil('\n', &(client->cHttpLine), std::bind(&WebSocketsClient::handleHeader, this, client, &(client->cHttpLine)));
+#endif
+
+    DEBUG_WEBSOCKETS("[WS-Client][sendHeader] sending header... Done (%luus).\n", (micros() - start));
+    _lastHeaderSent = millis();
+}
+
+/**
+ * build the http upgrade request, with client->cKey as a placeholder for the key
+ * @param client WSclient_t *  ptr to the client struct
+ * @param handshake String &  request
+ */
+void WebSocketsClient::buildHeader(WSclient_t * client, String & handshake) {
+    static const char * NEW_LINE = "\r\n";
+
     bool ws_header = true;
     String url     = client->cUrl;
 
@@ -689,6 +819,7 @@ void WebSocketsClient::sendHeader(WSclient_t * client) {
             "Upgrade: websocket\r\n"
             "Sec-WebSocket-Version: 13\r\n"
             "Sec-WebSocket-Key: ");
+        _handshakeKey = handshake.length();
         handshake += client->cKey + NEW_LINE;
 
         if(client->cProtocol.length() > 0) {
@@ -700,7 +831,12 @@ void WebSocketsClient::sendHeader(WSclient_t * client) {
             handshake += WEBSOCKETS_STRING("Sec-WebSocket-Extensions: ");
             handshake += client->cExtensions + NEW_LINE;
         }
+
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+        handshake += WEBSOCKETS_STRING("Sec-WebSocket-Extensions: " WEBSOCKETS_DEFLATE_OFFER "\r\n");
+#endif
     } else {
+        _handshakeKey = 0;
         handshake += WEBSOCKETS_STRING("Connection: keep-alive\r\n");
     }
 
@@ -722,16 +858,6 @@ void WebSocketsClient::sendHeader(WSclient_t * client) {
     }
 
     handshake += NEW_LINE;
-
-    DEBUG_WEBSOCKETS("[WS-Client][sendHeader] handshake %s", (uint8_t *)handshake.c_str());
-    write(client, (uint8_t *)handshake.c_str(), handshake.length());
-
-#if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-    client->tcp->readStringUntil('\n', &(client->cHttpLine), std::bind(&WebSocketsClient::handleHeader, this, client, &(client->cHttpLine)));
-#endif
-
-    DEBUG_WEBSOCKETS("[WS-Client][sendHeader] sending header... Done (%luus).\n", (micros() - start));
-    _lastHeaderSent = millis();
 }
 
 /**
@@ -866,6 +992,13 @@ void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine) {
             }
         }
 
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+        if(ok && !deflateAccept(client)) {
+            DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Sec-WebSocket-Extensions not acceptable\n");
+            ok = false;
+        }
+#endif
+
         if(ok) {
             DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Websocket connection init done.\n");
             headerDone(client);
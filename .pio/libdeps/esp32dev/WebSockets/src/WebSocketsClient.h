@@ -96,6 +96,10 @@ class WebSocketsClient : protected WebSockets {
     bool sendBIN(uint8_t * payload, size_t length, bool headerToPayload = false);
     bool sendBIN(const uint8_t * payload, size_t length);
 
+    uint8_t * getTxBuffer(size_t & capacity);
+    bool commitTXT(size_t length);
+    bool commitBIN(size_t length);
+
     bool sendPing(uint8_t * payload = NULL, size_t length = 0);
     bool sendPing(String & payload);
 
@@ -113,6 +117,12 @@ class WebSocketsClient : protected WebSockets {
 
     bool isConnected(void);
 
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    void setTxQueuePolicy(WStxPolicy_t policy);
+    size_t txQueued(void);
+    uint32_t txDropped(void);
+#endif
+
   protected:
     String _host;
     uint16_t _port;
@@ -154,7 +164,13 @@ class WebSocketsClient : protected WebSockets {
     unsigned long _reconnectInterval;
     unsigned long _lastHeaderSent;
 
+    String _handshake;         ///< upgrade request, built on the first connect
+    uint16_t _handshakeKey;    ///< offset of the Sec-WebSocket-Key value in it, 0: none
+
     void messageReceived(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin);
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    void txQueueEvent(WSclient_t * client, WStype_t type, size_t queued);
+#endif
 
     void clientDisconnect(WSclient_t * client);
     bool clientIsConnected(WSclient_t * client);
@@ -164,6 +180,7 @@ class WebSocketsClient : protected WebSockets {
 #endif
 
     void sendHeader(WSclient_t * client);
+    void buildHeader(WSclient_t * client, String & handshake);
     void handleHeader(WSclient_t * client, String * headerLine);
 
     void connectedCb();
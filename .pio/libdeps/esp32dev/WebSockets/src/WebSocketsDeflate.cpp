@@ -0,0 +1,536 @@
+/**
+ * @file WebSocketsDeflate.cpp
+ *
+ * permessage-deflate (RFC 7692) codec sized for small windows
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "WebSockets.h"
+
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+
+// candidates tried per position, more finds longer matches in more time
+#define WEBSOCKETS_DEFLATE_CHAIN (16)
+
+// RFC 1951 3.2.5
+static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// RFC 1951 3.2.7
+static const uint8_t codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+static inline uint16_t hash3(const uint8_t * data) {
+    uint32_t v = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | data[2];
+    return (uint16_t)((uint32_t)(v * 2654435761U) >> (32 - WEBSOCKETS_DEFLATE_HASH_BITS));
+}
+
+/**
+ * compresses one message against the window
+ * @param window WSdeflateWindow_t &  updated with the message on success
+ * @param in const uint8_t *
+ * @param length size_t
+ * @return compressed length at frame() + WEBSOCKETS_MAX_HEADER_SIZE, 0: send the message as it is
+ */
+size_t WebSocketsDeflate::compress(WSdeflateWindow_t & window, const uint8_t * in, size_t length) {
+    if(length == 0 || length > WEBSOCKETS_TX_BUFFER_SIZE) {
+        return 0;
+    }
+
+    size_t history = window.window ? window.fill : 0;
+    if(history) {
+        memcpy(_data, window.window, history);
+    }
+    memcpy(&_data[history], in, length);
+    size_t end         = history + length;
+    size_t maxDistance = (size_t)1 << window.bits;
+    if(maxDistance > WEBSOCKETS_DEFLATE_WINDOW) {
+        maxDistance = WEBSOCKETS_DEFLATE_WINDOW;
+    }
+
+    memset(_head, 0, sizeof(_head));
+    for(size_t pos = 0; pos < history; pos++) {
+        insert(pos, end);
+    }
+
+    // anything not smaller than the message is of no use
+    _outPos   = WEBSOCKETS_MAX_HEADER_SIZE;
+    _outCap   = WEBSOCKETS_MAX_HEADER_SIZE + length;
+    _bitBuf   = 0;
+    _bitCount = 0;
+
+    putBits(0, 1);    // BFINAL: more may follow, the message ends with a sync flush
+    putBits(1, 2);    // BTYPE: fixed Huffman codes
+
+    size_t pos = history;
+    while(pos < end) {
+        size_t bestLength   = 0;
+        size_t bestDistance = 0;
+
+        if(pos + 2 < end) {
+            size_t maxLength = end - pos;
+            if(maxLength > 258) {
+                maxLength = 258;
+            }
+            uint16_t candidate = _head[hash3(&_data[pos])];
+            uint8_t chain      = WEBSOCKETS_DEFLATE_CHAIN;
+            while(candidate && chain--) {
+                size_t match    = candidate - 1;
+                size_t distance = pos - match;
+                if(distance > maxDistance) {
+                    break;
+                }
+                size_t n = 0;
+                while(n < maxLength && _data[match + n] == _data[pos + n]) {
+                    n++;
+                }
+                if(n > bestLength) {
+                    bestLength   = n;
+                    bestDistance = distance;
+                    if(n == maxLength) {
+                        break;
+                    }
+                }
+                candidate = _prev[match & (WEBSOCKETS_DEFLATE_WINDOW - 1)];
+            }
+        }
+
+        if(bestLength >= 3) {
+            uint8_t code = 28;
+            while(lengthBase[code] > bestLength) {
+                code--;
+            }
+            putSymbol(257 + code);
+            putBits(bestLength - lengthBase[code], lengthExtra[code]);
+
+            code = 29;
+            while(distanceBase[code] > bestDistance) {
+                code--;
+            }
+            putCode(code, 5);
+            putBits(bestDistance - distanceBase[code], distanceExtra[code]);
+
+            while(bestLength--) {
+                insert(pos++, end);
+            }
+        } else {
+            putSymbol(_data[pos]);
+            insert(pos++, end);
+        }
+
+        if(_outPos >= _outCap) {
+            return 0;
+        }
+    }
+
+    putSymbol(256);    // end of block
+    // empty stored block of the sync flush, its LEN / NLEN (00 00 FF FF) are left off (RFC 7692 7.2.1)
+    putBits(0, 3);
+    if(_bitCount) {
+        putBits(0, 8 - _bitCount);
+    }
+
+    if(_outPos >= _outCap) {
+        return 0;
+    }
+
+    // the peer only sees compressed messages in its window, so only they go into ours
+    if(window.window) {
+        size_t keep = end < window.size ? end : window.size;
+        memcpy(window.window, &_data[end - keep], keep);
+        window.fill = keep;
+    }
+
+    return _outPos - WEBSOCKETS_MAX_HEADER_SIZE;
+}
+
+void WebSocketsDeflate::insert(size_t pos, size_t end) {
+    if(pos + 2 >= end) {
+        return;
+    }
+    uint16_t h                                   = hash3(&_data[pos]);
+    _prev[pos & (WEBSOCKETS_DEFLATE_WINDOW - 1)] = _head[h];
+    _head[h]                                     = pos + 1;
+}
+
+void WebSocketsDeflate::putBits(uint32_t value, uint8_t count) {
+    _bitBuf |= value << _bitCount;
+    _bitCount += count;
+    while(_bitCount >= 8) {
+        if(_outPos < _outCap) {
+            _frame[_outPos] = _bitBuf & 0xFF;
+        }
+        _outPos++;
+        _bitBuf >>= 8;
+        _bitCount -= 8;
+    }
+}
+
+/**
+ * Huffman codes are packed starting with their most significant bit
+ */
+void WebSocketsDeflate::putCode(uint16_t code, uint8_t length) {
+    uint16_t reversed = 0;
+    for(uint8_t i = 0; i < length; i++) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    putBits(reversed, length);
+}
+
+/**
+ * literal / length symbol with the fixed code (RFC 1951 3.2.6)
+ */
+void WebSocketsDeflate::putSymbol(uint16_t symbol) {
+    if(symbol < 144) {
+        putCode(0x30 + symbol, 8);
+    } else if(symbol < 256) {
+        putCode(0x190 + symbol - 144, 9);
+    } else if(symbol < 280) {
+        putCode(symbol - 256, 7);
+    } else {
+        putCode(0xC0 + symbol - 280, 8);
+    }
+}
+
+/**
+ * inflates one message, the window holds what the peer compressed before
+ * @param window WSdeflateWindow_t &  updated with the message on success
+ * @param in const uint8_t *  compressed payload (without the 00 00 FF FF tail)
+ * @param length size_t
+ * @param offset size_t &  start of the message in the returned buffer
+ * @param outLength size_t &  length of the message, a 0 terminator follows it
+ * @return malloc'ed buffer to free() after use, NULL: invalid data or out of memory
+ */
+uint8_t * WebSocketsDeflate::inflate(WSdeflateWindow_t & window, const uint8_t * in, size_t length, size_t & offset, size_t & outLength) {
+    size_t history = window.window ? window.fill : 0;
+
+    _in       = in;
+    _inLength = length;
+    _inPos    = 0;
+    _bitBuf   = 0;
+    _bitCount = 0;
+    _error    = false;
+
+    // back references may reach into the history, so the message is inflated behind a copy of it
+    _outMax  = history + WEBSOCKETS_MAX_DATA_SIZE;
+    _outSize = history + (length < 64 ? 256 : length * 4) + 1;
+    if(_outSize > _outMax + 1) {
+        _outSize = _outMax + 1;
+    }
+    _out = (uint8_t *)malloc(_outSize);
+    if(!_out) {
+        DEBUG_WEBSOCKETS("[WS][inflate] no memory (%d)!\n", _outSize);
+        return NULL;
+    }
+    if(history) {
+        memcpy(_out, window.window, history);
+    }
+    _outFill = history;
+
+    // the 4 Byte the sender removed are read back in by getBits()
+    bool ok   = true;
+    bool last = false;
+    while(ok && !last && _inPos < _inLength + 4) {
+        last          = getBits(1);
+        uint32_t type = getBits(2);
+        switch(type) {
+            case 0:
+                ok = stored();
+                break;
+            case 1:
+                ok = fixed();
+                break;
+            case 2:
+                ok = dynamic();
+                break;
+            default:
+                ok = false;
+                break;
+        }
+        ok = ok && !_error;
+    }
+
+    if(!ok) {
+        DEBUG_WEBSOCKETS("[WS][inflate] invalid data\n");
+        free(_out);
+        return NULL;
+    }
+
+    _out[_outFill] = 0x00;
+    offset         = history;
+    outLength      = _outFill - history;
+
+    if(window.window) {
+        size_t keep = _outFill < window.size ? _outFill : window.size;
+        memcpy(window.window, &_out[_outFill - keep], keep);
+        window.fill = keep;
+    }
+
+    return _out;
+}
+
+uint32_t WebSocketsDeflate::getBits(uint8_t count) {
+    uint32_t value = _bitBuf;
+    while(_bitCount < count) {
+        uint8_t next;
+        if(_inPos < _inLength) {
+            next = _in[_inPos];
+        } else if(_inPos < _inLength + 4) {
+            next = (_inPos - _inLength < 2) ? 0x00 : 0xFF;
+        } else {
+            _error = true;
+            return 0;
+        }
+        _inPos++;
+        value |= (uint32_t)next << _bitCount;
+        _bitCount += 8;
+    }
+    _bitBuf = value >> count;
+    _bitCount -= count;
+    return value & ((1UL << count) - 1);
+}
+
+/**
+ * room for n more Byte and the terminator
+ */
+bool WebSocketsDeflate::reserve(size_t n) {
+    if(_outFill + n + 1 <= _outSize) {
+        return true;
+    }
+    if(_outFill + n > _outMax) {
+        DEBUG_WEBSOCKETS("[WS][inflate] message too big\n");
+        return false;
+    }
+    size_t size = _outSize * 2;
+    if(size < _outFill + n + 1) {
+        size = _outFill + n + 1;
+    }
+    if(size > _outMax + 1) {
+        size = _outMax + 1;
+    }
+    uint8_t * out = (uint8_t *)realloc(_out, size);
+    if(!out) {
+        DEBUG_WEBSOCKETS("[WS][inflate] no memory (%d)!\n", size);
+        return false;
+    }
+    _out     = out;
+    _outSize = size;
+    return true;
+}
+
+/**
+ * canonical code from code lengths (RFC 1951 3.2.2)
+ * @return 0: complete, > 0: incomplete, < 0: over-subscribed
+ */
+int WebSocketsDeflate::build(WShuffman_t * h, const uint8_t * lengths, int n) {
+    uint16_t offs[16];
+
+    memset(h->count, 0, sizeof(h->count));
+    for(int symbol = 0; symbol < n; symbol++) {
+        h->count[lengths[symbol]]++;
+    }
+    if(h->count[0] == n) {
+        return 0;
+    }
+
+    int left = 1;
+    for(int len = 1; len < 16; len++) {
+        left <<= 1;
+        left -= h->count[len];
+        if(left < 0) {
+            return left;
+        }
+    }
+
+    offs[1] = 0;
+    for(int len = 1; len < 15; len++) {
+        offs[len + 1] = offs[len] + h->count[len];
+    }
+    for(int symbol = 0; symbol < n; symbol++) {
+        if(lengths[symbol] != 0) {
+            h->symbol[offs[lengths[symbol]]++] = symbol;
+        }
+    }
+    return left;
+}
+
+int WebSocketsDeflate::decode(WShuffman_t * h) {
+    int code  = 0;
+    int first = 0;
+    int index = 0;
+    for(int len = 1; len < 16; len++) {
+        code |= getBits(1);
+        int count = h->count[len];
+        if(code - count < first) {
+            return h->symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+bool WebSocketsDeflate::stored(void) {
+    // rest of the current byte is padding
+    _bitBuf   = 0;
+    _bitCount = 0;
+
+    uint32_t len  = getBits(16);
+    uint32_t nlen = getBits(16);
+    if(_error || len != (~nlen & 0xFFFF)) {
+        return false;
+    }
+    if(!reserve(len)) {
+        return false;
+    }
+    while(len--) {
+        _out[_outFill++] = getBits(8);
+    }
+    return !_error;
+}
+
+bool WebSocketsDeflate::fixed(void) {
+    int symbol = 0;
+    for(; symbol < 144; symbol++) {
+        _lengths[symbol] = 8;
+    }
+    for(; symbol < 256; symbol++) {
+        _lengths[symbol] = 9;
+    }
+    for(; symbol < 280; symbol++) {
+        _lengths[symbol] = 7;
+    }
+    for(; symbol < 288; symbol++) {
+        _lengths[symbol] = 8;
+    }
+    build(&_lencode, _lengths, 288);
+
+    memset(_lengths, 5, 30);
+    build(&_distcode, _lengths, 30);
+
+    return codes();
+}
+
+bool WebSocketsDeflate::dynamic(void) {
+    int nlen  = getBits(5) + 257;
+    int ndist = getBits(5) + 1;
+    int ncode = getBits(4) + 4;
+    if(_error || nlen > 286 || ndist > 30) {
+        return false;
+    }
+
+    memset(_lengths, 0, 19);
+    for(int index = 0; index < ncode; index++) {
+        _lengths[codeLengthOrder[index]] = getBits(3);
+    }
+    if(build(&_lencode, _lengths, 19) != 0) {
+        return false;
+    }
+
+    int index = 0;
+    while(index < nlen + ndist) {
+        int symbol = decode(&_lencode);
+        if(symbol < 0 || _error) {
+            return false;
+        }
+        if(symbol < 16) {
+            _lengths[index++] = symbol;
+            continue;
+        }
+        uint8_t len = 0;
+        if(symbol == 16) {
+            if(index == 0) {
+                return false;
+            }
+            len    = _lengths[index - 1];
+            symbol = 3 + getBits(2);
+        } else if(symbol == 17) {
+            symbol = 3 + getBits(3);
+        } else {
+            symbol = 11 + getBits(7);
+        }
+        if(index + symbol > nlen + ndist) {
+            return false;
+        }
+        while(symbol--) {
+            _lengths[index++] = len;
+        }
+    }
+
+    // no end of block code
+    if(_lengths[256] == 0) {
+        return false;
+    }
+
+    // incomplete codes are only allowed for a single length
+    int err = build(&_lencode, _lengths, nlen);
+    if(err < 0 || (err > 0 && nlen - _lencode.count[0] != 1)) {
+        return false;
+    }
+    err = build(&_distcode, &_lengths[nlen], ndist);
+    if(err < 0 || (err > 0 && ndist - _distcode.count[0] != 1)) {
+        return false;
+    }
+
+    return codes();
+}
+
+bool WebSocketsDeflate::codes(void) {
+    for(;;) {
+        int symbol = decode(&_lencode);
+        if(symbol < 0 || _error) {
+            return false;
+        }
+        if(symbol < 256) {
+            if(!reserve(1)) {
+                return false;
+            }
+            _out[_outFill++] = symbol;
+        } else if(symbol == 256) {
+            return true;
+        } else {
+            symbol -= 257;
+            if(symbol >= 29) {
+                return false;
+            }
+            size_t len = lengthBase[symbol] + getBits(lengthExtra[symbol]);
+
+            symbol = decode(&_distcode);
+            if(symbol < 0 || symbol >= 30) {
+                return false;
+            }
+            size_t distance = distanceBase[symbol] + getBits(distanceExtra[symbol]);
+            if(_error || distance > _outFill || !reserve(len)) {
+                return false;
+            }
+
+            // may overlap: byte by byte
+            uint8_t * to         = &_out[_outFill];
+            const uint8_t * from = to - distance;
+            _outFill += len;
+            while(len--) {
+                *to++ = *from++;
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,105 @@
+/**
+ * @file WebSocketsDeflate.h
+ *
+ * permessage-deflate (RFC 7692) codec sized for small windows
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef WEBSOCKETSDEFLATE_H_
+#define WEBSOCKETSDEFLATE_H_
+
+// included from WebSockets.h once WEBSOCKETS_DEFLATE_WINDOW_BITS and the buffer sizes are set
+
+#define WEBSOCKETS_DEFLATE_WINDOW (1 << WEBSOCKETS_DEFLATE_WINDOW_BITS)
+#define WEBSOCKETS_DEFLATE_HASH_BITS (9)
+
+/**
+ * LZ77 window of one direction of one connection.
+ * window == NULL: no_context_takeover, every message stands alone
+ */
+typedef struct {
+    uint8_t * window = nullptr;    ///< last Byte of the (uncompressed) stream
+    uint16_t size    = 0;          ///< capacity of window: 1 << bits
+    uint16_t fill    = 0;          ///< Byte in window
+    uint8_t bits     = 0;          ///< negotiated max_window_bits
+} WSdeflateWindow_t;
+
+typedef struct {
+    uint16_t count[16];      ///< number of codes per length
+    uint16_t symbol[288];    ///< symbols ordered by code
+} WShuffman_t;
+
+/**
+ * One instance is shared by all connections of a client / server,
+ * only the windows are per connection.
+ *
+ * The compressor emits a single fixed Huffman block with greedy hash chain
+ * matches: no tree to build or send, which suits the short, repetitive
+ * messages of a sensor. The inflater takes any deflate stream (stored, fixed
+ * and dynamic blocks) as long as its window fits the negotiated one.
+ */
+class WebSocketsDeflate {
+  public:
+    size_t compress(WSdeflateWindow_t & window, const uint8_t * in, size_t length);
+    uint8_t * frame(void) {
+        return _frame;
+    }
+
+    uint8_t * inflate(WSdeflateWindow_t & window, const uint8_t * in, size_t length, size_t & offset, size_t & outLength);
+
+  private:
+    // compressor
+    uint8_t _data[WEBSOCKETS_DEFLATE_WINDOW + WEBSOCKETS_TX_BUFFER_SIZE];      ///< history + message
+    uint16_t _head[1 << WEBSOCKETS_DEFLATE_HASH_BITS];                         ///< newest position + 1 per hash
+    uint16_t _prev[WEBSOCKETS_DEFLATE_WINDOW];                                 ///< older position + 1 with the same hash
+    uint8_t _frame[WEBSOCKETS_MAX_HEADER_SIZE + WEBSOCKETS_TX_BUFFER_SIZE];    ///< header headroom + compressed message
+    size_t _outPos;
+    size_t _outCap;
+
+    void insert(size_t pos, size_t end);
+    void putBits(uint32_t value, uint8_t count);
+    void putCode(uint16_t code, uint8_t length);
+    void putSymbol(uint16_t symbol);
+
+    // both
+    uint32_t _bitBuf;
+    uint8_t _bitCount;
+
+    // inflater
+    WShuffman_t _lencode;
+    WShuffman_t _distcode;
+    uint8_t _lengths[320];
+    const uint8_t * _in;
+    size_t _inLength;
+    size_t _inPos;
+    uint8_t * _out;
+    size_t _outFill;
+    size_t _outSize;
+    size_t _outMax;
+    bool _error;
+
+    uint32_t getBits(uint8_t count);
+    bool reserve(size_t n);
+    int build(WShuffman_t * h, const uint8_t * lengths, int n);
+    int decode(WShuffman_t * h);
+    bool stored(void);
+    bool fixed(void);
+    bool dynamic(void);
+    bool codes(void);
+};
+
+#endif /* WEBSOCKETSDEFLATE_H_ */
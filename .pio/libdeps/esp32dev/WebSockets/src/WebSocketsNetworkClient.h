@@ -26,4 +26,7 @@ class WebSocketsNetworkClient : public Client {
     virtual void stop();
     virtual uint8_t connected();
     virtual operator bool();
+#ifdef WEBSOCKETS_NATIVE
+    int fd() const;    // host socket, written directly by the send queue
+#endif
 };
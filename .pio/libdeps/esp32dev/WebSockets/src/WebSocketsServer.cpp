@@ -33,7 +33,14 @@
 #endif    // defined __has_include
 #endif
 
-WebSocketsServerCore::WebSocketsServerCore(const String & origin, const String & protocol) {
+WebSocketsServerCore::WebSocketsServerCore(const String & origin, const String & protocol, uint8_t clientMax) {
+    _clientMax   = clientMax;
+    _clients     = new WSclient_t[_clientMax];
+    _freeSlots   = new uint8_t[_clientMax];
+    _activeSlots = new uint8_t[_clientMax];
+    _activeIndex = new uint8_t[_clientMax];
+    resetSlots();
+
     _origin                 = origin;
     _protocol               = protocol;
     _runnning               = false;
@@ -48,8 +55,8 @@ WebSocketsServerCore::WebSocketsServerCore(const String & origin, const String &
     _mandatoryHttpHeaderCount = 0;
 }
 
-WebSocketsServer::WebSocketsServer(uint16_t port, const String & origin, const String & protocol)
-    : WebSocketsServerCore(origin, protocol) {
+WebSocketsServer::WebSocketsServer(uint16_t port, const String & origin, const String & protocol, uint8_t clientMax)
+    : WebSocketsServerCore(origin, protocol, clientMax) {
     _port = port;
 
     _server = new WEBSOCKETS_NETWORK_SERVER_CLASS(port);
@@ -70,6 +77,11 @@ WebSocketsServerCore::~WebSocketsServerCore() {
         delete[] _mandatoryHttpHeaders;
 
     _mandatoryHttpHeaderCount = 0;
+
+    delete[] _clients;
+    delete[] _freeSlots;
+    delete[] _activeSlots;
+    delete[] _activeIndex;
 }
 
 WebSocketsServer::~WebSocketsServer() {
@@ -89,9 +101,10 @@ void WebSocketsServerCore::begin(void) {
     // all its members are initialized to their default value,
     // except the ones explicitly detailed in WSclient_t() constructor.
     // Then we need to initialize some members to non-trivial values:
-    for(int i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    for(int i = 0; i < _clientMax; i++) {
         _clients[i].init(i, _pingInterval, _pongTimeout, _disconnectTimeoutCount);
     }
+    resetSlots();
 
 #ifdef ESP8266
     randomSeed(RANDOM_REG32);
@@ -118,9 +131,70 @@ void WebSocketsServerCore::close(void) {
 
     // restore _clients[] to their initial state
     // before next call to ::begin()
-    for(int i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    for(int i = 0; i < _clientMax; i++) {
         _clients[i] = WSclient_t();
     }
+    resetSlots();
+}
+
+/**
+ * mark every slot unused; the lowest slot numbers are handed out first
+ */
+void WebSocketsServerCore::resetSlots(void) {
+    _activeCount = 0;
+    _freeCount   = 0;
+    for(uint8_t i = _clientMax; i-- > 0;) {
+        _freeSlots[_freeCount++] = i;
+    }
+}
+
+/**
+ * take a slot off the free stack
+ * @return WSclient_t * or NULL if all slots are in use
+ */
+WSclient_t * WebSocketsServerCore::acquireClient(void) {
+    if(_freeCount == 0) {
+        return NULL;
+    }
+    uint8_t num                  = _freeSlots[--_freeCount];
+    _activeIndex[num]            = _activeCount;
+    _activeSlots[_activeCount++] = num;
+    return &_clients[num];
+}
+
+/**
+ * give a slot back; the last active slot takes its place in the list.
+ * Does nothing for a slot that is not in use.
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSocketsServerCore::releaseClient(WSclient_t * client) {
+    uint8_t num = client->num;
+    if(num >= _clientMax || client != &_clients[num]) {
+        return;
+    }
+    uint8_t pos = _activeIndex[num];
+    if(pos >= _activeCount || _activeSlots[pos] != num) {
+        return;
+    }
+    uint8_t last             = _activeSlots[--_activeCount];
+    _activeSlots[pos]        = last;
+    _activeIndex[last]       = pos;
+    _freeSlots[_freeCount++] = num;
+}
+
+/**
+ * i-th slot in use. Callers walk the list from the end: a slot released
+ * meanwhile (even several, from inside an event callback) is replaced by one
+ * that was already visited, so none is skipped; an index past the shrunken
+ * list gives NULL.
+ * @param i uint8_t
+ * @return WSclient_t * or NULL
+ */
+WSclient_t * WebSocketsServerCore::activeClient(uint8_t i) {
+    if(i >= _activeCount) {
+        return NULL;
+    }
+    return &_clients[_activeSlots[i]];
 }
 
 /**
@@ -163,7 +237,7 @@ void WebSocketsServerCore::onValidateHttpHeader(
  * @return true if ok
  */
 bool WebSocketsServerCore::sendTXT(uint8_t num, uint8_t * payload, size_t length, bool headerToPayload) {
-    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+    if(num >= _clientMax) {
         return false;
     }
     if(length == 0) {
@@ -200,22 +274,10 @@ bool WebSocketsServerCore::sendTXT(uint8_t num, String & payload) {
  * @return true if ok
  */
 bool WebSocketsServerCore::broadcastTXT(uint8_t * payload, size_t length, bool headerToPayload) {
-    WSclient_t * client;
-    bool ret = true;
     if(length == 0) {
         length = strlen((const char *)payload);
     }
-
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
-        if(clientIsConnected(client)) {
-            if(!sendFrame(client, WSop_text, payload, length, true, headerToPayload)) {
-                ret = false;
-            }
-        }
-        WEBSOCKETS_YIELD();
-    }
-    return ret;
+    return broadcastFrame(WSop_text, payload, length, headerToPayload);
 }
 
 bool WebSocketsServerCore::broadcastTXT(const uint8_t * payload, size_t length) {
@@ -243,7 +305,7 @@ bool WebSocketsServerCore::broadcastTXT(String & payload) {
  * @return true if ok
  */
 bool WebSocketsServerCore::sendBIN(uint8_t num, uint8_t * payload, size_t length, bool headerToPayload) {
-    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+    if(num >= _clientMax) {
         return false;
     }
     WSclient_t * client = &_clients[num];
@@ -265,24 +327,79 @@ bool WebSocketsServerCore::sendBIN(uint8_t num, const uint8_t * payload, size_t
  * @return true if ok
  */
 bool WebSocketsServerCore::broadcastBIN(uint8_t * payload, size_t length, bool headerToPayload) {
-    WSclient_t * client;
-    bool ret = true;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
-        if(clientIsConnected(client)) {
-            if(!sendFrame(client, WSop_binary, payload, length, true, headerToPayload)) {
-                ret = false;
-            }
-        }
-        WEBSOCKETS_YIELD();
-    }
-    return ret;
+    return broadcastFrame(WSop_binary, payload, length, headerToPayload);
 }
 
 bool WebSocketsServerCore::broadcastBIN(const uint8_t * payload, size_t length) {
     return broadcastBIN((uint8_t *)payload, length);
 }
 
+/**
+ * get the reusable tx buffer to build a message in place (no heap, no copy on send).
+ * Exactly one commitTXT() / commitBIN() must follow before the buffer can be requested again.
+ * @param capacity size_t &     set to the max payload length
+ * @return uint8_t * payload area or NULL
+ */
+uint8_t * WebSocketsServerCore::getTxBuffer(size_t & capacity) {
+    return leaseTxBuffer(capacity);
+}
+
+/**
+ * send the text written to the tx buffer to one client
+ * @param num uint8_t client id
+ * @param length size_t
+ * @return true if ok
+ */
+bool WebSocketsServerCore::commitTXT(uint8_t num, size_t length) {
+    if(num >= _clientMax || !clientIsConnected(&_clients[num])) {
+        _txBufferLeased = false;
+        return false;
+    }
+    return commitTxBuffer(&_clients[num], WSop_text, length);
+}
+
+/**
+ * send the binary data written to the tx buffer to one client
+ * @param num uint8_t client id
+ * @param length size_t
+ * @return true if ok
+ */
+bool WebSocketsServerCore::commitBIN(uint8_t num, size_t length) {
+    if(num >= _clientMax || !clientIsConnected(&_clients[num])) {
+        _txBufferLeased = false;
+        return false;
+    }
+    return commitTxBuffer(&_clients[num], WSop_binary, length);
+}
+
+/**
+ * send the text written to the tx buffer to all clients, encoded once
+ * @param length size_t
+ * @return true if ok
+ */
+bool WebSocketsServerCore::commitBroadcastTXT(size_t length) {
+    if(!_txBufferLeased) {
+        return false;
+    }
+    bool ret = (length > 0 && length <= WEBSOCKETS_TX_BUFFER_SIZE && broadcastFrame(WSop_text, _txBuffer, length, true));
+    _txBufferLeased = false;
+    return ret;
+}
+
+/**
+ * send the binary data written to the tx buffer to all clients, encoded once
+ * @param length size_t
+ * @return true if ok
+ */
+bool WebSocketsServerCore::commitBroadcastBIN(size_t length) {
+    if(!_txBufferLeased) {
+        return false;
+    }
+    bool ret = (length > 0 && length <= WEBSOCKETS_TX_BUFFER_SIZE && broadcastFrame(WSop_binary, _txBuffer, length, true));
+    _txBufferLeased = false;
+    return ret;
+}
+
 /**
  * sends a WS ping to Client
  * @param num uint8_t client id
@@ -291,7 +408,7 @@ bool WebSocketsServerCore::broadcastBIN(const uint8_t * payload, size_t length)
  * @return true if ping is send out
  */
 bool WebSocketsServerCore::sendPing(uint8_t num, uint8_t * payload, size_t length) {
-    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+    if(num >= _clientMax) {
         return false;
     }
     WSclient_t * client = &_clients[num];
@@ -312,18 +429,7 @@ bool WebSocketsServerCore::sendPing(uint8_t num, String & payload) {
  * @return true if ping is send out
  */
 bool WebSocketsServerCore::broadcastPing(uint8_t * payload, size_t length) {
-    WSclient_t * client;
-    bool ret = true;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
-        if(clientIsConnected(client)) {
-            if(!sendFrame(client, WSop_ping, payload, length)) {
-                ret = false;
-            }
-        }
-        WEBSOCKETS_YIELD();
-    }
-    return ret;
+    return broadcastFrame(WSop_ping, payload, length, false);
 }
 
 bool WebSocketsServerCore::broadcastPing(String & payload) {
@@ -335,9 +441,9 @@ bool WebSocketsServerCore::broadcastPing(String & payload) {
  */
 void WebSocketsServerCore::disconnect(void) {
     WSclient_t * client;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
-        if(clientIsConnected(client)) {
+    for(uint8_t i = _activeCount; i-- > 0;) {
+        client = activeClient(i);
+        if(client && clientIsConnected(client)) {
             WebSockets::clientDisconnect(client, 1000);
         }
     }
@@ -348,7 +454,7 @@ void WebSocketsServerCore::disconnect(void) {
  * @param num uint8_t client id
  */
 void WebSocketsServerCore::disconnect(uint8_t num) {
-    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+    if(num >= _clientMax) {
         return;
     }
     WSclient_t * client = &_clients[num];
@@ -388,10 +494,10 @@ void WebSocketsServerCore::setAuthorization(const char * auth) {
 int WebSocketsServerCore::connectedClients(bool ping) {
     WSclient_t * client;
     int count = 0;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
-        if(client->status == WSC_CONNECTED) {
-            if(ping != true || sendPing(i)) {
+    for(uint8_t i = _activeCount; i-- > 0;) {
+        client = activeClient(i);
+        if(client && client->status == WSC_CONNECTED) {
+            if(ping != true || sendPing(client->num)) {
                 count++;
             }
         }
@@ -404,7 +510,7 @@ int WebSocketsServerCore::connectedClients(bool ping) {
  * @param num uint8_t client id
  */
 bool WebSocketsServerCore::clientIsConnected(uint8_t num) {
-    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+    if(num >= _clientMax) {
         return false;
     }
     WSclient_t * client = &_clients[num];
@@ -418,7 +524,7 @@ bool WebSocketsServerCore::clientIsConnected(uint8_t num) {
  * @return IPAddress
  */
 IPAddress WebSocketsServerCore::remoteIP(uint8_t num) {
-    if(num < WEBSOCKETS_SERVER_CLIENT_MAX) {
+    if(num < _clientMax) {
         WSclient_t * client = &_clients[num];
         if(clientIsConnected(client)) {
             return client->tcp->remoteIP();
@@ -439,67 +545,74 @@ IPAddress WebSocketsServerCore::remoteIP(uint8_t num) {
  */
 WSclient_t * WebSocketsServerCore::newClient(WEBSOCKETS_NETWORK_CLASS * TCPclient) {
     WSclient_t * client;
-    // search free list entry for client
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
 
-        // look for match to existing socket before creating a new one
-        if(clientIsConnected(client)) {
+    // look for match to existing socket before creating a new one; when the
+    // table is full this also frees the slots of connections that were lost
+    bool sweep = (_freeCount == 0);
+#if (WEBSOCKETS_NETWORK_TYPE == NETWORK_W5100)
+    sweep = true;
+#endif
+    for(uint8_t i = sweep ? _activeCount : 0; i-- > 0;) {
+        client = activeClient(i);
+        if(client && clientIsConnected(client)) {
 #if (WEBSOCKETS_NETWORK_TYPE == NETWORK_W5100)
             // Check to see if it is the same socket - if so, return it
             if(client->tcp->getSocketNumber() == TCPclient->getSocketNumber()) {
                 return client;
             }
 #endif
-        } else {
-            // state is not connected or tcp connection is lost
-            client->tcp = TCPclient;
+        }
+    }
+
+    client = acquireClient();
+    if(!client) {
+        return nullptr;
+    }
+
+    client->tcp = TCPclient;
 
 #if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32)
-            client->isSSL = false;
-            client->tcp->setNoDelay(true);
+    client->isSSL = false;
+    client->tcp->setNoDelay(true);
 #endif
 #if (WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
-            // set Timeout for readBytesUntil and readStringUntil
-            client->tcp->setTimeout(WEBSOCKETS_TCP_TIMEOUT);
+    // set Timeout for readBytesUntil and readStringUntil
+    client->tcp->setTimeout(WEBSOCKETS_TCP_TIMEOUT);
 #endif
-            client->status = WSC_HEADER;
+    client->status = WSC_HEADER;
 #if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040)
 #ifndef NODEBUG_WEBSOCKETS
-            IPAddress ip = client->tcp->remoteIP();
+    IPAddress ip = client->tcp->remoteIP();
 #endif
-            DEBUG_WEBSOCKETS("[WS-Server][%d] new client from %d.%d.%d.%d\n", client->num, ip[0], ip[1], ip[2], ip[3]);
+    DEBUG_WEBSOCKETS("[WS-Server][%d] new client from %d.%d.%d.%d\n", client->num, ip[0], ip[1], ip[2], ip[3]);
 #else
-            DEBUG_WEBSOCKETS("[WS-Server][%d] new client\n", client->num);
+    DEBUG_WEBSOCKETS("[WS-Server][%d] new client\n", client->num);
 #endif
 
 #if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-            client->tcp->onDisconnect(std::bind([](WebSocketsServerCore * server, AsyncTCPbuffer * obj, WSclient_t * client) -> bool {
-                DEBUG_WEBSOCKETS("[WS-Server][%d] Disconnect client\n", client->num);
-
-                AsyncTCPbuffer ** sl = &server->_clients[client->num].tcp;
-                if(*sl == obj) {
-                    client->status = WSC_NOT_CONNECTED;
-                    *sl            = NULL;
-                }
-                return true;
-            },
-                this, std::placeholders::_1, client));
+    client->tcp->onDisconnect(std::bind([](WebSocketsServerCore * server, AsyncTCPbuffer * obj, WSclient_t * client) -> bool {
+        DEBUG_WEBSOCKETS("[WS-Server][%d] Disconnect client\n", client->num);
+
+        AsyncTCPbuffer ** sl = &server->_clients[client->num].tcp;
+        if(*sl == obj) {
+            client->status = WSC_NOT_CONNECTED;
+            *sl            = NULL;
+            server->releaseClient(client);
+        }
+        return true;
+    },
+        this, std::placeholders::_1, client));
 
-            client->tcp->readStringUntil('\n', &(client->cHttpLine), std::bind(&WebSocketsServerCore::handleHeader, this, client, &(client->cHttpLine)));
+    client->tcp->readStringUntil('\n', &(client->cHttpLine), std::bind(&WebSocketsServerCore::handleHeader, this, client, &(client->cHttpLine)));
 #endif
 
-            client->pingInterval           = _pingInterval;
-            client->pongTimeout            = _pongTimeout;
-            client->disconnectTimeoutCount = _disconnectTimeoutCount;
-            client->lastPing               = millis();
-            client->pongReceived           = false;
+    client->pingInterval           = _pingInterval;
+    client->pongTimeout            = _pongTimeout;
+    client->disconnectTimeoutCount = _disconnectTimeoutCount;
+    client->lastPing               = millis();
+    client->pongReceived           = false;
 
-            return client;
-            break;
-        }
-    }
-    return nullptr;
+    return client;
 }
 
 /**
@@ -536,6 +649,18 @@ void WebSocketsServerCore::messageReceived(WSclient_t * client, WSopcode_t opcod
     runCbEvent(client->num, type, payload, length);
 }
 
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+/**
+ * send queue of a client crossed a watermark
+ * @param client WSclient_t *  ptr to the client struct
+ * @param type WStype_t        WStype_TX_HIGH_WATER or WStype_TX_LOW_WATER
+ * @param queued size_t        Byte in the queue
+ */
+void WebSocketsServerCore::txQueueEvent(WSclient_t * client, WStype_t type, size_t queued) {
+    runCbEvent(client->num, type, NULL, queued);
+}
+#endif
+
 /**
  * Discard a native client
  * @param client WSclient_t *  ptr to the client struct contaning the native client "->tcp"
@@ -590,11 +715,23 @@ void WebSocketsServerCore::clientDisconnect(WSclient_t * client) {
 
     client->cWsRXsize = 0;
 
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+    client->cExtensions = "";
+    deflateReset(client);
+#endif
+
 #if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
     client->cHttpLine = "";
 #endif
+#ifdef WEBSOCKETS_NONBLOCKING_READ
+    readCbAbort(client);
+#endif
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    txQueueReset(client);
+#endif
 
     client->status = WSC_NOT_CONNECTED;
+    releaseClient(client);
 
     DEBUG_WEBSOCKETS("[WS-Server][%d] client disconnected.\n", client->num);
 
@@ -694,9 +831,12 @@ void WebSocketsServer::handleNewClients(void) {
  */
 void WebSocketsServerCore::handleClientData(void) {
     WSclient_t * client;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
-        client = &_clients[i];
-        if(clientIsConnected(client)) {
+    for(uint8_t i = _activeCount; i-- > 0;) {
+        client = activeClient(i);
+        if(client && clientIsConnected(client)) {
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+            txQueueFlush(client);
+#endif
             int len = client->tcp->available();
             if(len > 0) {
                 // DEBUG_WEBSOCKETS("[WS-Server][%d][handleClientData] len: %d\n", client->num, len);
@@ -713,6 +853,11 @@ void WebSocketsServerCore::handleClientData(void) {
                         WebSockets::clientDisconnect(client, 1002);
                         break;
                 }
+#ifdef WEBSOCKETS_NONBLOCKING_READ
+            } else if(client->cRxReadPtr) {
+                // nothing new, only check the pending read for timeout
+                readCbResume(client);
+#endif
             }
 
             handleHBPing(client);
@@ -873,6 +1018,14 @@ void WebSocketsServerCore::handleHeader(WSclient_t * client, String * headerLine
                 handshake += _protocol + NEW_LINE;
             }
 
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+            String extensions = deflateAnswer(client);
+            if(extensions.length() > 0) {
+                handshake += WEBSOCKETS_STRING("Sec-WebSocket-Extensions: ");
+                handshake += extensions + NEW_LINE;
+            }
+#endif
+
             // header end
             handshake += NEW_LINE;
 
@@ -893,6 +1046,78 @@ void WebSocketsServerCore::handleHeader(WSclient_t * client, String * headerLine
     }
 }
 
+/**
+ * send one frame to every connected client.
+ * Server frames are not masked, so the frame is the same bytes for every
+ * client: the header is built once and put in front of the payload (in
+ * place with headerToPayload, else in the tx buffer), and only the socket
+ * writes are repeated per client. Without room for that, header and
+ * payload are written separately, still without copying.
+ * Clients with permessage-deflate get their own frame.
+ * @param opcode WSopcode_t
+ * @param payload uint8_t *
+ * @param length size_t
+ * @param headerToPayload bool  (see sendFrame for more details)
+ * @return true if ok
+ */
+bool WebSocketsServerCore::broadcastFrame(WSopcode_t opcode, uint8_t * payload, size_t length, bool headerToPayload) {
+    uint8_t maskKey[4] = { 0x00, 0x00, 0x00, 0x00 };
+    uint8_t header[WEBSOCKETS_MAX_HEADER_SIZE];
+    uint8_t headerSize = createHeader(&header[0], opcode, length, false, maskKey, true);
+
+    // the tx buffer stays leased while we write from it, so no event
+    // callback can build its own message in there meanwhile
+    bool ownLease = false;
+#ifdef WEBSOCKETS_USE_BIG_MEM
+    if(!headerToPayload && length > 0 && length <= WEBSOCKETS_TX_BUFFER_SIZE && !_txBufferLeased && allocTxBuffer()) {
+        memcpy(_txBuffer + WEBSOCKETS_MAX_HEADER_SIZE, payload, length);
+        payload         = _txBuffer;
+        headerToPayload = true;
+        ownLease        = true;
+        _txBufferLeased = true;
+    }
+#endif
+
+    uint8_t * frame = NULL;
+    if(headerToPayload) {
+        frame = payload + (WEBSOCKETS_MAX_HEADER_SIZE - headerSize);
+        memcpy(frame, &header[0], headerSize);
+        payload += WEBSOCKETS_MAX_HEADER_SIZE;
+    }
+
+    // a slow client only drops its own copy (send queue), the others are not held up
+    bool droppable = (opcode == WSop_text || opcode == WSop_binary);
+
+    WSclient_t * client;
+    bool ret = true;
+    for(uint8_t i = _activeCount; i-- > 0;) {
+        client = activeClient(i);
+        if(client && clientIsConnected(client) && client->status == WSC_CONNECTED) {
+#ifdef WEBSOCKETS_DEFLATE_WINDOW_BITS
+            if(client->cDeflate) {
+                // compressed against the client's own window, no shared frame
+                if(!sendFrame(client, opcode, payload, length)) {
+                    ret = false;
+                }
+            } else
+#endif
+            if(frame) {
+                if(!writeFrame(client, frame, headerSize + length, NULL, 0, droppable)) {
+                    ret = false;
+                }
+            } else if(!writeFrame(client, &header[0], headerSize, payload, length, droppable)) {
+                ret = false;
+            }
+        }
+        WEBSOCKETS_YIELD();
+    }
+
+    if(ownLease) {
+        _txBufferLeased = false;
+    }
+    return ret;
+}
+
 /**
  * send heartbeat ping to server in set intervals
  */
@@ -921,7 +1146,7 @@ void WebSocketsServerCore::enableHeartbeat(uint32_t pingInterval, uint32_t pongT
     _disconnectTimeoutCount = disconnectTimeoutCount;
 
     WSclient_t * client;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    for(uint8_t i = 0; i < _clientMax; i++) {
         client = &_clients[i];
         WebSockets::enableHeartbeat(client, pingInterval, pongTimeout, disconnectTimeoutCount);
     }
@@ -934,12 +1159,22 @@ void WebSocketsServerCore::disableHeartbeat() {
     _pingInterval = 0;
 
     WSclient_t * client;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    for(uint8_t i = 0; i < _clientMax; i++) {
         client               = &_clients[i];
         client->pingInterval = 0;
     }
 }
 
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+/**
+ * what to drop when the send queue of a client is full
+ * @param policy WStxPolicy_t
+ */
+void WebSocketsServerCore::setTxQueuePolicy(WStxPolicy_t policy) {
+    _txPolicy = policy;
+}
+#endif
+
 ////////////////////
 // WebSocketServer
 
@@ -27,13 +27,14 @@
 
 #include "WebSockets.h"
 
+// default size of the client table; the constructors take any size up to 255
 #ifndef WEBSOCKETS_SERVER_CLIENT_MAX
 #define WEBSOCKETS_SERVER_CLIENT_MAX (5)
 #endif
 
 class WebSocketsServerCore : protected WebSockets {
   public:
-    WebSocketsServerCore(const String & origin = "", const String & protocol = "arduino");
+    WebSocketsServerCore(const String & origin = "", const String & protocol = "arduino", uint8_t clientMax = WEBSOCKETS_SERVER_CLIENT_MAX);
     virtual ~WebSocketsServerCore(void);
 
     void begin(void);
@@ -71,6 +72,12 @@ class WebSocketsServerCore : protected WebSockets {
     bool broadcastBIN(uint8_t * payload, size_t length, bool headerToPayload = false);
     bool broadcastBIN(const uint8_t * payload, size_t length);
 
+    uint8_t * getTxBuffer(size_t & capacity);
+    bool commitTXT(uint8_t num, size_t length);
+    bool commitBIN(uint8_t num, size_t length);
+    bool commitBroadcastTXT(size_t length);
+    bool commitBroadcastBIN(size_t length);
+
     bool sendPing(uint8_t num, uint8_t * payload = NULL, size_t length = 0);
     bool sendPing(uint8_t num, String & payload);
 
@@ -84,12 +91,19 @@ class WebSocketsServerCore : protected WebSockets {
     void setAuthorization(const char * auth);
 
     int connectedClients(bool ping = false);
+    uint8_t clientMax(void) const {
+        return _clientMax;
+    }
 
     bool clientIsConnected(uint8_t num);
 
     void enableHeartbeat(uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount);
     void disableHeartbeat();
 
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    void setTxQueuePolicy(WStxPolicy_t policy);
+#endif
+
 #if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_RP2040)
     IPAddress remoteIP(uint8_t num);
 #endif
@@ -107,7 +121,17 @@ class WebSocketsServerCore : protected WebSockets {
     String * _mandatoryHttpHeaders;
     size_t _mandatoryHttpHeaderCount;
 
-    WSclient_t _clients[WEBSOCKETS_SERVER_CLIENT_MAX];
+    // Client table, allocated once. Unused slots sit on a free stack and the
+    // slots in use are listed in _activeSlots (a sparse set: _activeIndex maps
+    // a slot back to its position), so accepting a client is O(1) and loop()
+    // and the broadcasts only visit connections that exist.
+    WSclient_t * _clients;
+    uint8_t _clientMax;
+    uint8_t * _freeSlots;
+    uint8_t _freeCount;
+    uint8_t * _activeSlots;
+    uint8_t * _activeIndex;
+    uint8_t _activeCount;
 
     WebSocketServerEvent _cbEvent;
     WebSocketServerHttpHeaderValFunc _httpHeaderValidationFunc;
@@ -119,10 +143,18 @@ class WebSocketsServerCore : protected WebSockets {
     uint8_t _disconnectTimeoutCount;
 
     void messageReceived(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin);
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    void txQueueEvent(WSclient_t * client, WStype_t type, size_t queued);
+#endif
 
     void clientDisconnect(WSclient_t * client);
     bool clientIsConnected(WSclient_t * client);
 
+    void resetSlots(void);
+    WSclient_t * acquireClient(void);
+    void releaseClient(WSclient_t * client);
+    WSclient_t * activeClient(uint8_t i);
+
 #if (WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
     void handleClientData(void);
 #endif
@@ -131,6 +163,8 @@ class WebSocketsServerCore : protected WebSockets {
 
     void handleHBPing(WSclient_t * client);    // send ping in specified intervals
 
+    bool broadcastFrame(WSopcode_t opcode, uint8_t * payload, size_t length, bool headerToPayload);
+
     /**
      * called if a non Websocket connection is coming in.
      * Note: can be override
@@ -218,7 +252,7 @@ class WebSocketsServerCore : protected WebSockets {
 
 class WebSocketsServer : public WebSocketsServerCore {
   public:
-    WebSocketsServer(uint16_t port, const String & origin = "", const String & protocol = "arduino");
+    WebSocketsServer(uint16_t port, const String & origin = "", const String & protocol = "arduino", uint8_t clientMax = WEBSOCKETS_SERVER_CLIENT_MAX);
     virtual ~WebSocketsServer(void);
 
     void begin(void);
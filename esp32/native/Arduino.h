@@ -0,0 +1,46 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino core the firmware and the
+// WebSockets library use. Only meant for the `native` PlatformIO env.
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define FPSTR(p) (p)
+#define strlen_P strlen
+#define strncpy_P strncpy
+#define memcpy_P memcpy
+
+#define bit(b) (1UL << (b))
+
+using std::max;
+using std::min;
+
+// Monotonic, counted from the first call
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "IPAddress.h"
+#include "HardwareSerial.h"
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <deque>
+
+#include "Stream.h"
+
+#define SERIAL_8N1 0x800001c
+
+// Host UART. Writes go to stdout. The receive side replays bytes scheduled
+// with inject(), e.g. from a capture of the sensor's output: each byte
+// becomes readable at its own time, paced at the configured baud rate as if
+// it had just come off the wire, and arrivedAt() reports when the last byte
+// handed out was "received". Reads are safe against injection from another
+// thread.
+class HardwareSerial : public Stream {
+  public:
+    explicit HardwareSerial(int uart) : _uart(uart) {}
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1);
+    void end() {}
+
+    // Queue `length` bytes; the first becomes readable at `atMicros` (or
+    // right after the bytes already queued, if that is later).
+    void inject(const uint8_t* data, size_t length, uint64_t atMicros);
+
+    // Bytes still waiting (readable now or later)
+    size_t pending();
+    // Micros at which the last byte handed out by a read became readable
+    uint64_t arrivedAt() const { return _arrivedAt; }
+    void setQuiet(bool quiet) { _quiet = quiet; }
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t readBytes(char* buffer, size_t length) override;
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+  private:
+    struct Chunk {
+        uint64_t at;    // micros the first byte becomes readable
+        std::string bytes;
+    };
+
+    size_t readable(uint64_t now);
+
+    int _uart;
+    uint32_t _byteMicros = 87;    // 10 bits at 115200
+    bool _quiet = false;
+
+    std::mutex _lock;
+    std::deque<Chunk> _chunks;     // in order, front one partially consumed
+    size_t _chunkOffset = 0;
+    uint64_t _queuedUntil = 0;
+    uint64_t _arrivedAt = 0;
+};
+
+extern HardwareSerial Serial;
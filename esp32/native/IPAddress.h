@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "WString.h"
+
+class IPAddress {
+  public:
+    IPAddress() : _address{ 0, 0, 0, 0 } {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _address{ a, b, c, d } {}
+
+    uint8_t operator[](int index) const { return _address[index]; }
+    uint8_t& operator[](int index) { return _address[index]; }
+    bool operator==(const IPAddress& other) const {
+        return _address[0] == other._address[0] && _address[1] == other._address[1]
+            && _address[2] == other._address[2] && _address[3] == other._address[3];
+    }
+    String toString() const {
+        char buffer[16];
+        snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", _address[0], _address[1], _address[2], _address[3]);
+        return String(buffer);
+    }
+
+    explicit operator bool() const { return _address[0] || _address[1] || _address[2] || _address[3]; }
+
+  private:
+    uint8_t _address[4];
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+// LittleFS backed by a host directory (LITTLEFS_ROOT, default ".pio/littlefs").
+class File {
+  public:
+    File() {}
+    explicit File(FILE* file) : _file(file) {}
+
+    explicit operator bool() const { return _file != nullptr; }
+    bool seek(uint32_t position) { return _file && fseek(_file, position, SEEK_SET) == 0; }
+    size_t read(uint8_t* buffer, size_t size) { return _file ? fread(buffer, 1, size, _file) : 0; }
+    size_t write(const uint8_t* buffer, size_t size) { return _file ? fwrite(buffer, 1, size, _file) : 0; }
+    void flush() {
+        if (_file) {
+            fflush(_file);
+        }
+    }
+    void close() {
+        if (_file) {
+            fclose(_file);
+        }
+        _file = nullptr;
+    }
+
+  private:
+    FILE* _file = nullptr;
+};
+
+class LittleFSFS {
+  public:
+    bool begin(bool formatOnFail = false);
+    bool exists(const char* path);
+    bool remove(const char* path);
+    File open(const char* path, const char* mode);
+
+  private:
+    std::string _root;
+};
+
+extern LittleFSFS LittleFS;
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+// NVS backed by one text file per namespace in a host directory
+// (NVS_ROOT, default ".pio/nvs"). Only what the firmware uses.
+class Preferences {
+  public:
+    bool begin(const char* name, bool readOnly = false);
+    void end();
+
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+    size_t putUInt(const char* key, uint32_t value);
+
+  private:
+    bool save();
+
+    std::string _path;
+    bool _readOnly = false;
+    std::map<std::string, uint32_t> _values;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "WString.h"
+
+#ifndef DEC
+#define DEC 10
+#define HEX 16
+#endif
+
+class Print {
+  public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (n < size && write(buffer[n])) {
+            n++;
+        }
+        return n;
+    }
+    size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+    virtual void flush() {}
+
+    size_t print(const char* str) { return write(str); }
+    size_t print(const String& str) { return write((const uint8_t*)str.c_str(), str.length()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(long value, int base = DEC) { return printNumber(value, base, true); }
+    size_t print(unsigned long value, int base = DEC) { return printNumber(value, base, false); }
+    size_t print(int value, int base = DEC) { return print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(double value, int digits = 2) { return printf("%.*f", digits, value); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T& value) { return print(value) + println(); }
+    template <typename T>
+    size_t println(const T& value, int format) { return print(value, format) + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (len < 0) {
+            return 0;
+        }
+        return write((const uint8_t*)buffer, (size_t)len < sizeof(buffer) ? len : sizeof(buffer) - 1);
+    }
+
+  private:
+    size_t printNumber(long value, int base, bool isSigned) {
+        char buffer[34];
+        if (base == HEX) {
+            snprintf(buffer, sizeof(buffer), "%lX", (unsigned long)value);
+        } else if (isSigned) {
+            snprintf(buffer, sizeof(buffer), "%ld", value);
+        } else {
+            snprintf(buffer, sizeof(buffer), "%lu", (unsigned long)value);
+        }
+        return write(buffer);
+    }
+};
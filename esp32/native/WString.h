@@ -0,0 +1,125 @@
+#pragma once
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#include <string>
+
+// Arduino String on top of std::string, with the subset the firmware and
+// the WebSockets library call.
+class String {
+  public:
+    String() {}
+    String(const char* str) : _s(str ? str : "") {}
+    String(const std::string& str) : _s(str) {}
+    explicit String(char c) : _s(1, c) {}
+    explicit String(int value) : _s(std::to_string(value)) {}
+    explicit String(unsigned int value) : _s(std::to_string(value)) {}
+    explicit String(long value) : _s(std::to_string(value)) {}
+    explicit String(unsigned long value) : _s(std::to_string(value)) {}
+
+    const char* c_str() const { return _s.c_str(); }
+    unsigned int length() const { return (unsigned int)_s.length(); }
+    bool isEmpty() const { return _s.empty(); }
+    bool reserve(unsigned int size) {
+        _s.reserve(size);
+        return true;
+    }
+
+    char operator[](unsigned int index) const { return index < _s.length() ? _s[index] : 0; }
+    char& operator[](unsigned int index) { return _s[index]; }
+
+    String& operator=(const char* str) {
+        _s = str ? str : "";
+        return *this;
+    }
+    String& operator+=(const String& other) { return concat(other); }
+    String& operator+=(const char* str) { return concat(str); }
+    String& operator+=(char c) { return concat(c); }
+    String& operator+=(int value) { return concat(String(value)); }
+    String& operator+=(unsigned int value) { return concat(String(value)); }
+    String& operator+=(long value) { return concat(String(value)); }
+    String& operator+=(unsigned long value) { return concat(String(value)); }
+
+    String& concat(const String& other) {
+        _s += other._s;
+        return *this;
+    }
+    String& concat(const char* str) {
+        if (str) {
+            _s += str;
+        }
+        return *this;
+    }
+    String& concat(char c) {
+        _s += c;
+        return *this;
+    }
+
+    bool operator==(const String& other) const { return _s == other._s; }
+    bool operator==(const char* str) const { return _s == (str ? str : ""); }
+    bool operator!=(const String& other) const { return _s != other._s; }
+    bool operator!=(const char* str) const { return !(*this == str); }
+    bool equals(const String& other) const { return _s == other._s; }
+    bool equalsIgnoreCase(const String& other) const {
+        return _s.length() == other._s.length() && strcasecmp(_s.c_str(), other._s.c_str()) == 0;
+    }
+    bool startsWith(const String& prefix) const { return _s.compare(0, prefix._s.length(), prefix._s) == 0; }
+
+    int indexOf(char c, unsigned int from = 0) const { return position(_s.find(c, from)); }
+    int indexOf(const String& str, unsigned int from = 0) const { return position(_s.find(str._s, from)); }
+    int indexOf(const char* str, unsigned int from = 0) const { return position(_s.find(str, from)); }
+    int lastIndexOf(char c) const { return position(_s.rfind(c)); }
+
+    String substring(unsigned int from) const { return from < _s.length() ? String(_s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) {
+            std::swap(from, to);
+        }
+        return from < _s.length() ? String(_s.substr(from, to - from)) : String();
+    }
+
+    void remove(unsigned int index) {
+        if (index < _s.length()) {
+            _s.erase(index);
+        }
+    }
+    void remove(unsigned int index, unsigned int count) {
+        if (index < _s.length()) {
+            _s.erase(index, count);
+        }
+    }
+    void trim() {
+        size_t begin = 0;
+        size_t end = _s.length();
+        while (begin < end && isspace((unsigned char)_s[begin])) {
+            begin++;
+        }
+        while (end > begin && isspace((unsigned char)_s[end - 1])) {
+            end--;
+        }
+        _s = _s.substr(begin, end - begin);
+    }
+    void toLowerCase() {
+        for (size_t i = 0; i < _s.length(); i++) {
+            _s[i] = (char)tolower((unsigned char)_s[i]);
+        }
+    }
+    long toInt() const { return strtol(_s.c_str(), nullptr, 10); }
+
+    friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+    friend String operator+(const String& a, const char* b) { return String(a._s + (b ? b : "")); }
+    friend String operator+(const char* a, const String& b) { return String((a ? a : "") + b._s); }
+    friend String operator+(const String& a, char b) { return String(a._s + b); }
+    friend String operator+(const String& a, int b) { return a + String(b); }
+    friend String operator+(const String& a, unsigned int b) { return a + String(b); }
+    friend String operator+(const String& a, long b) { return a + String(b); }
+    friend String operator+(const String& a, unsigned long b) { return a + String(b); }
+
+  private:
+    static int position(size_t found) { return found == std::string::npos ? -1 : (int)found; }
+
+    std::string _s;
+};
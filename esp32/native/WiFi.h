@@ -0,0 +1,29 @@
+#pragma once
+
+#include "IPAddress.h"
+#include "WString.h"
+#include "WiFiClient.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1 } wifi_mode_t;
+
+// The host's network is always up; association is not simulated.
+class WiFiClass {
+  public:
+    wl_status_t begin(const char* ssid, const char* password = nullptr) { return WL_CONNECTED; }
+    bool disconnect(bool wifiOff = false) { return true; }
+    bool mode(wifi_mode_t mode) { return true; }
+    wl_status_t status() { return WL_CONNECTED; }
+    IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+    int8_t RSSI() { return 0; }
+    String macAddress() { return "00:00:00:00:00:00"; }
+};
+
+extern WiFiClass WiFi;
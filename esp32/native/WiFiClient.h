@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+
+#include "Client.h"
+
+// TCP client on a POSIX socket. Copies share the socket, as on the ESP32.
+class WiFiClient : public Client {
+  public:
+    WiFiClient() {}
+    explicit WiFiClient(int fd);
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char* host, uint16_t port) override;
+    int connect(const char* host, uint16_t port, int32_t timeoutMs);
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buffer, size_t size) override;
+    int peek() override;
+    void flush() override {}
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return connected(); }
+    using Print::write;
+
+    void setNoDelay(bool noDelay);
+    IPAddress remoteIP() const;
+    int fd() const;
+
+  private:
+    struct Socket;
+    std::shared_ptr<Socket> _socket;
+};
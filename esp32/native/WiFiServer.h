@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "WiFiClient.h"
+
+// Listening is not needed by the bench (the board is always the client);
+// this only lets WebSocketsServer build.
+class WiFiServer {
+  public:
+    explicit WiFiServer(uint16_t port) : _port(port) {}
+
+    void begin() {}
+    void end() {}
+    void close() {}
+    bool hasClient() { return false; }
+    WiFiClient accept() { return WiFiClient(); }
+    WiFiClient available() { return WiFiClient(); }
+
+  private:
+    uint16_t _port;
+};
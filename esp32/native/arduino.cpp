@@ -0,0 +1,179 @@
+#include <Arduino.h>
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+// ----- Time -----
+
+static const std::chrono::steady_clock::time_point bootTime = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - bootTime).count();
+}
+
+unsigned long micros() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - bootTime).count();
+}
+
+void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+// ----- Random -----
+
+static std::minstd_rand randomEngine;
+
+long random(long max) {
+    return max > 0 ? (long)(randomEngine() % (unsigned long)max) : 0;
+}
+
+long random(long min, long max) {
+    return max > min ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed) {
+    randomEngine.seed(seed);
+}
+
+// ----- Stream -----
+
+int Stream::timedRead() {
+    unsigned long start = millis();
+    do {
+        int c = read();
+        if (c >= 0) {
+            return c;
+        }
+        yield();
+    } while (millis() - start < _timeout);
+    return -1;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+        int c = timedRead();
+        if (c < 0) {
+            break;
+        }
+        buffer[count++] = (char)c;
+    }
+    return count;
+}
+
+String Stream::readStringUntil(char terminator) {
+    String out;
+    int c = timedRead();
+    while (c >= 0 && c != terminator) {
+        out += (char)c;
+        c = timedRead();
+    }
+    return out;
+}
+
+// ----- HardwareSerial -----
+
+HardwareSerial Serial(0);
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin) {
+    if (baud > 0) {
+        _byteMicros = (uint32_t)((10UL * 1000000UL + baud - 1) / baud);
+    }
+}
+
+void HardwareSerial::inject(const uint8_t* data, size_t length, uint64_t atMicros) {
+    if (length == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(_lock);
+    Chunk chunk;
+    chunk.at = atMicros > _queuedUntil ? atMicros : _queuedUntil;
+    chunk.bytes.assign((const char*)data, length);
+    _queuedUntil = chunk.at + (uint64_t)length * _byteMicros;
+    _chunks.push_back(chunk);
+}
+
+size_t HardwareSerial::pending() {
+    std::lock_guard<std::mutex> guard(_lock);
+    size_t count = 0;
+    for (size_t i = 0; i < _chunks.size(); i++) {
+        count += _chunks[i].bytes.size();
+    }
+    return count - _chunkOffset;
+}
+
+// Bytes of the front chunk that have "arrived" by `now`. Caller holds _lock.
+size_t HardwareSerial::readable(uint64_t now) {
+    while (!_chunks.empty() && _chunkOffset == _chunks.front().bytes.size()) {
+        _chunks.pop_front();
+        _chunkOffset = 0;
+    }
+    if (_chunks.empty() || now < _chunks.front().at) {
+        return 0;
+    }
+    const Chunk& chunk = _chunks.front();
+    size_t arrived = (size_t)((now - chunk.at) / _byteMicros) + 1;
+    if (arrived > chunk.bytes.size()) {
+        arrived = chunk.bytes.size();
+    }
+    return arrived > _chunkOffset ? arrived - _chunkOffset : 0;
+}
+
+int HardwareSerial::available() {
+    std::lock_guard<std::mutex> guard(_lock);
+    return (int)readable(micros());
+}
+
+int HardwareSerial::peek() {
+    std::lock_guard<std::mutex> guard(_lock);
+    if (readable(micros()) == 0) {
+        return -1;
+    }
+    return (uint8_t)_chunks.front().bytes[_chunkOffset];
+}
+
+int HardwareSerial::read() {
+    uint8_t c;
+    return readBytes((char*)&c, 1) == 1 ? c : -1;
+}
+
+// Never waits: like the ESP32 driver with the data already in the FIFO,
+// callers are expected to ask available() first.
+size_t HardwareSerial::readBytes(char* buffer, size_t length) {
+    std::lock_guard<std::mutex> guard(_lock);
+    size_t count = 0;
+    size_t n;
+    while (count < length && (n = readable(micros())) > 0) {
+        Chunk& chunk = _chunks.front();
+        if (n > length - count) {
+            n = length - count;
+        }
+        memcpy(buffer + count, chunk.bytes.data() + _chunkOffset, n);
+        _chunkOffset += n;
+        count += n;
+        _arrivedAt = chunk.at + (uint64_t)(_chunkOffset - 1) * _byteMicros;
+    }
+    return count;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    if (!_quiet) {
+        fwrite(buffer, 1, size, stdout);
+    }
+    return size;
+}
@@ -0,0 +1,447 @@
+// Host benchmark for the firmware data path.
+//
+// Replays a UART capture (or synthetic LD2450 reports) through the real
+// Pipeline -- framer, decoder, SPSC queue, sample log, batcher, WebSocket
+// client -- against a running Node server, with the sensor and network
+// sides on two threads like the two FreeRTOS tasks on the board. Reports,
+// per sample:
+//   uart->queue   last byte of the report readable -> sample decoded and queued
+//   uart->socket  ... -> its telemetry packet handed to the TCP socket
+//   uart->ack     ... -> the server's cumulative ack received
+// and how many heap allocations the firmware made per sample once connected.
+//
+//   pio run -e native && .pio/build/native/program --capture sensor.bin
+//
+// Times are host times: they show where latency and allocations come from
+// and catch regressions, not what the ESP32 will measure.
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <WebSocketsClient.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mask_bench.h"
+#include "pipeline.h"
+#include "radar_check.h"
+#include "radar_protocol.h"
+
+// ===== Firmware =====
+
+WebSocketsClient webSocket;
+HardwareSerial mmwaveSerial(2);
+Pipeline pipeline(webSocket, "bench");
+
+// ===== Allocation counting =====
+// glibc only: the replacements forward to the real allocator. Counts every
+// thread, so the bench itself does not allocate while counting is on.
+static std::atomic<bool> countAllocations(false);
+static std::atomic<uint64_t> allocationCount(0);
+static std::atomic<uint64_t> allocationBytes(0);
+
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+
+static void countAllocation(size_t size) {
+    if (countAllocations.load(std::memory_order_relaxed)) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+void* malloc(size_t size) {
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    countAllocation(size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+}
+#define ALLOCATIONS_COUNTED 1
+#else
+#define ALLOCATIONS_COUNTED 0
+#endif
+
+// ===== Options =====
+struct Options {
+    const char* host = "127.0.0.1";
+    uint16_t port = 3000;
+    const char* path = "/ws";
+    const char* capture = nullptr;
+    uint32_t synthetic = 600;    // reports, when there is no capture
+    uint32_t rate = 10;          // reports/s; 0 = back to back at line rate
+    uint32_t baud = 115200;
+    uint32_t timeoutMs = 10000;  // after the last byte, for acks to come in
+    bool verbose = false;
+    bool mask = false;           // masking benchmark only, no server needed
+    bool radar = false;          // radar frame check only, no server needed
+};
+
+static void usage() {
+    printf("usage: program [--host H] [--port P] [--path /ws] [--capture FILE | --synthetic N]\n"
+           "               [--rate HZ] [--baud B] [--timeout MS] [--verbose]\n"
+           "       program --mask\n"
+           "       program --radar\n");
+}
+
+static bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(arg, "--verbose")) {
+            options.verbose = true;
+            continue;
+        }
+        if (!strcmp(arg, "--mask")) {
+            options.mask = true;
+            continue;
+        }
+        if (!strcmp(arg, "--radar")) {
+            options.radar = true;
+            continue;
+        }
+        if (!value) {
+            return false;
+        }
+        i++;
+        if (!strcmp(arg, "--host")) {
+            options.host = value;
+        } else if (!strcmp(arg, "--port")) {
+            options.port = (uint16_t)atoi(value);
+        } else if (!strcmp(arg, "--path")) {
+            options.path = value;
+        } else if (!strcmp(arg, "--capture")) {
+            options.capture = value;
+        } else if (!strcmp(arg, "--synthetic")) {
+            options.synthetic = strtoul(value, nullptr, 10);
+        } else if (!strcmp(arg, "--rate")) {
+            options.rate = strtoul(value, nullptr, 10);
+        } else if (!strcmp(arg, "--baud")) {
+            options.baud = strtoul(value, nullptr, 10);
+        } else if (!strcmp(arg, "--timeout")) {
+            options.timeoutMs = strtoul(value, nullptr, 10);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ===== UART input =====
+
+static void putSignMagnitude(std::vector<uint8_t>& out, int value) {
+    uint16_t raw = value >= 0 ? (uint16_t)(0x8000 | value) : (uint16_t)-value;
+    out.push_back(raw & 0xFF);
+    out.push_back(raw >> 8);
+}
+
+// LD2450 reports of one person walking across the room, leaving for a
+// while every 100 reports so presence changes (and early flushes) happen.
+static std::vector<uint8_t> syntheticCapture(uint32_t reports) {
+    std::vector<uint8_t> out;
+    for (uint32_t i = 0; i < reports; i++) {
+        static const uint8_t header[] = { 0xAA, 0xFF, 0x03, 0x00 };
+        out.insert(out.end(), header, header + sizeof(header));
+
+        bool present = i % 100 < 80;
+        if (present) {
+            int step = (int)(i % 100);
+            putSignMagnitude(out, -1500 + step * 37);    // x mm
+            putSignMagnitude(out, 2000 + (step % 10) * 25);    // y mm
+            putSignMagnitude(out, -16);                  // cm/s
+            out.push_back(0x68);                         // gate resolution 360 mm
+            out.push_back(0x01);
+        } else {
+            out.insert(out.end(), 8, 0);
+        }
+        out.insert(out.end(), 16, 0);    // two empty slots
+
+        out.push_back(0x55);
+        out.push_back(0xCC);
+    }
+    return out;
+}
+
+// Splits a capture into what the sensor sends in one go: a radar report or
+// a text line. Anything else sticks to the chunk it arrived in.
+static size_t splitCapture(const std::vector<uint8_t>& data, std::vector<std::pair<size_t, size_t> >& chunks) {
+    size_t reports = 0;
+    size_t start = 0;
+    size_t i = 0;
+    while (i < data.size()) {
+        int size = radarFrameSize(&data[i], data.size() - i);
+        if (size > 0 && (size_t)size <= data.size() - i) {
+            i += size;
+            reports++;
+        } else if (data[i++] != '\n') {
+            continue;
+        }
+        chunks.push_back(std::make_pair(start, i));
+        start = i;
+    }
+    if (start < data.size()) {
+        chunks.push_back(std::make_pair(start, data.size()));
+    }
+    return reports;
+}
+
+static bool loadCapture(const char* path, std::vector<uint8_t>& data) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return true;
+}
+
+// ===== Tracing =====
+// Indexed by seq - seqBase - 1 (seqs carry on across runs, like across
+// resets on the board); sized up front so the hooks never allocate.
+struct SampleTimes {
+    uint64_t arrived;    // micros the report's last byte became readable
+    uint64_t queued;
+    uint64_t sent;
+    uint64_t acked;
+};
+
+static std::vector<SampleTimes> times;
+static std::atomic<uint32_t> samplesTraced(0);
+static uint32_t seqBase = 0;
+static uint32_t ackedUpTo = 0;    // samples of this run acked
+static uint32_t packetsSent = 0;
+static uint64_t bytesSent = 0;
+
+// Sensor thread
+static void traceSample(const PresenceSample& sample, void* ctx) {
+    if (sample.seq <= seqBase || sample.seq - seqBase > times.size()) {
+        return;
+    }
+    SampleTimes& t = times[sample.seq - seqBase - 1];
+    t.arrived = mmwaveSerial.arrivedAt();
+    t.queued = micros();
+    samplesTraced.fetch_add(1, std::memory_order_release);
+}
+
+// Network thread
+static void tracePacket(const uint8_t* data, size_t length, void* ctx) {
+    uint64_t now = micros();
+    packetsSent++;
+    bytesSent += length;
+
+    uint32_t seqs[32];
+    size_t count = telemetryPacketSeqs(data, length, seqs, sizeof(seqs) / sizeof(seqs[0]));
+    for (size_t i = 0; i < count; i++) {
+        uint32_t index = seqs[i] - seqBase - 1;
+        if (seqs[i] > seqBase && index < times.size() && times[index].sent == 0) {
+            times[index].sent = now;
+        }
+    }
+}
+
+// ===== Network task =====
+
+static std::mutex wakeLock;
+static std::condition_variable wake;
+static bool woken = false;
+static bool connected = false;
+
+static void notifyNetwork(void* ctx) {
+    std::lock_guard<std::mutex> guard(wakeLock);
+    woken = true;
+    wake.notify_one();
+}
+
+static void onWebSocketEvent(WStype_t type, uint8_t* payload, size_t length) {
+    if (type == WStype_CONNECTED) {
+        connected = true;
+    } else if (type == WStype_DISCONNECTED) {
+        connected = false;
+    }
+    if (!pipeline.handleEvent(type, payload, length) || type != WStype_TEXT) {
+        return;
+    }
+
+    // An ack: stamp everything it covers
+    const char* seq = strstr((const char*)payload, "\"seq\":");
+    uint32_t upTo = seq ? strtoul(seq + 6, nullptr, 10) : 0;
+    uint64_t now = micros();
+    while (ackedUpTo + seqBase < upTo && ackedUpTo < times.size()) {
+        times[ackedUpTo++].acked = now;
+    }
+}
+
+// One pass of the network task
+static void networkPass(uint32_t waitMs) {
+    webSocket.loop();
+    pipeline.pollNetwork();
+
+    std::unique_lock<std::mutex> guard(wakeLock);
+    wake.wait_for(guard, std::chrono::milliseconds(waitMs), [] { return woken; });
+    woken = false;
+}
+
+// ===== Report =====
+
+static uint64_t percentile(std::vector<uint64_t>& values, double p) {
+    size_t index = (size_t)(p * (values.size() - 1) + 0.5);
+    return values[index];
+}
+
+static void reportLatency(const char* name, uint64_t SampleTimes::*to, uint32_t samples) {
+    std::vector<uint64_t> values;
+    for (uint32_t i = 0; i < samples; i++) {
+        const SampleTimes& t = times[i];
+        if (t.*to >= t.arrived && t.*to != 0 && t.arrived != 0) {
+            values.push_back(t.*to - t.arrived);
+        }
+    }
+    if (values.empty()) {
+        printf("  %-13s no samples\n", name);
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    printf("  %-13s p50 %8.2f  p95 %8.2f  p99 %8.2f  max %8.2f ms  (%u samples)\n", name,
+        percentile(values, 0.50) / 1000.0, percentile(values, 0.95) / 1000.0,
+        percentile(values, 0.99) / 1000.0, values.back() / 1000.0, (unsigned)values.size());
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+    if (options.mask) {
+        return maskBench(Serial) ? 0 : 1;
+    }
+    if (options.radar) {
+        return radarCheck(Serial) ? 0 : 1;
+    }
+
+    std::vector<uint8_t> capture;
+    if (options.capture) {
+        if (!loadCapture(options.capture, capture)) {
+            printf("cannot read %s\n", options.capture);
+            return 1;
+        }
+    } else {
+        capture = syntheticCapture(options.synthetic);
+    }
+    std::vector<std::pair<size_t, size_t> > chunks;
+    size_t reports = splitCapture(capture, chunks);
+    times.assign(reports, SampleTimes());
+    printf("Input: %u bytes, %u radar reports, %u chunks at %u/s, %u baud\n", (unsigned)capture.size(),
+        (unsigned)reports, (unsigned)chunks.size(), (unsigned)options.rate, (unsigned)options.baud);
+
+    Serial.setQuiet(!options.verbose);
+    mmwaveSerial.begin(options.baud, SERIAL_8N1, 16, 17);
+
+    // Start from an empty log, so only this run's samples are timed
+    LittleFS.begin(true);
+    LittleFS.remove(SAMPLE_LOG_SPILL_PATH);
+    pipeline.begin(notifyNetwork);
+    seqBase = pipeline.firstSeq() - 1;
+    pipeline.setHooks(traceSample, tracePacket, nullptr);
+
+    webSocket.begin(options.host, options.port, options.path);
+    webSocket.onEvent(onWebSocketEvent);
+    webSocket.setReconnectInterval(1000);
+
+    unsigned long deadline = millis() + 5000;
+    while (!connected && millis() < deadline) {
+        networkPass(10);
+    }
+    if (!connected) {
+        printf("no WebSocket connection to ws://%s:%u%s\n", options.host, (unsigned)options.port, options.path);
+        return 1;
+    }
+
+    // Sensor side, polled like sensorTask
+    std::atomic<bool> running(true);
+    std::thread sensor([&running] {
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+        while (running.load(std::memory_order_relaxed)) {
+            pipeline.pollSensor(mmwaveSerial);
+            next += std::chrono::milliseconds(2);
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    uint64_t start = micros() + 10000;
+    uint64_t period = options.rate ? 1000000ULL / options.rate : 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        mmwaveSerial.inject(&capture[chunks[i].first], chunks[i].second - chunks[i].first, start + i * period);
+    }
+
+    countAllocations.store(true);
+    unsigned long drainedAt = 0;
+    for (;;) {
+        networkPass(10);
+        if (mmwaveSerial.pending() > 0) {
+            continue;
+        }
+        if (drainedAt == 0) {
+            drainedAt = millis();
+        }
+        uint32_t traced = samplesTraced.load(std::memory_order_acquire);
+        if ((traced > 0 && ackedUpTo >= traced && millis() - drainedAt > 50) || millis() - drainedAt > options.timeoutMs) {
+            break;
+        }
+    }
+    countAllocations.store(false);
+
+    running.store(false);
+    sensor.join();
+    double seconds = (micros() - start) / 1e6;
+
+    uint32_t samples = samplesTraced.load();
+    printf("Samples: %u decoded, %u acked, %u packets, %lu bytes in %.1f s\n", (unsigned)samples,
+        (unsigned)ackedUpTo, (unsigned)packetsSent, (unsigned long)bytesSent, seconds);
+    printf("Framer: %u reports, %u lines, %u resyncs, %u overflows; queue drops %u; log lost %u\n",
+        (unsigned)pipeline.framer().binaryFramesEmitted(),
+        (unsigned)pipeline.framer().framesEmitted(),
+        (unsigned)pipeline.framer().resyncs(), (unsigned)pipeline.framer().overflows(),
+        (unsigned)pipeline.sampleDrops(), (unsigned)pipeline.log().lost());
+    printf("Changes: %u reports sent, %u suppressed as unchanged\n", (unsigned)pipeline.changeFilter().passed(),
+        (unsigned)pipeline.changeFilter().suppressed());
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    printf("Link: congested %u times, %u messages dropped by the send queue\n", (unsigned)pipeline.congestions(),
+        (unsigned)webSocket.txDropped());
+#endif
+    printf("Latency:\n");
+    reportLatency("uart->queue", &SampleTimes::queued, samples);
+    reportLatency("uart->socket", &SampleTimes::sent, samples);
+    reportLatency("uart->ack", &SampleTimes::acked, samples);
+#if ALLOCATIONS_COUNTED
+    printf("Allocations: %lu (%lu bytes), %.2f per sample\n", (unsigned long)allocationCount.load(),
+        (unsigned long)allocationBytes.load(), samples ? (double)allocationCount.load() / samples : 0.0);
+#else
+    printf("Allocations: not counted on this libc\n");
+#endif
+    return ackedUpTo >= samples && samples > 0 ? 0 : 1;
+}
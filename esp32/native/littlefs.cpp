@@ -0,0 +1,27 @@
+#include <LittleFS.h>
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+LittleFSFS LittleFS;
+
+bool LittleFSFS::begin(bool formatOnFail) {
+    const char* root = getenv("LITTLEFS_ROOT");
+    _root = root ? root : ".pio/littlefs";
+    mkdir(_root.c_str(), 0755);
+    struct stat info;
+    return stat(_root.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+bool LittleFSFS::exists(const char* path) {
+    return access((_root + path).c_str(), F_OK) == 0;
+}
+
+bool LittleFSFS::remove(const char* path) {
+    return ::remove((_root + path).c_str()) == 0;
+}
+
+File LittleFSFS::open(const char* path, const char* mode) {
+    return File(fopen((_root + path).c_str(), mode));
+}
@@ -0,0 +1,96 @@
+#include "mask_bench.h"
+
+#include <Arduino.h>
+#include <WebSockets.h>
+
+// maskPayload() is protected: it is only meant for the frame code
+struct MaskAccess : WebSockets {
+    using WebSockets::maskPayload;
+};
+
+// The loop sendFrame() and handleWebsocketPayloadCb() had before
+static void maskBytes(uint8_t* data, size_t length, const uint8_t* maskKey) {
+    for (size_t x = 0; x < length; x++) {
+        data[x] ^= maskKey[x % 4];
+    }
+}
+
+static bool maskCheck(Print& out) {
+    static uint8_t expected[300 + 8];
+    static uint8_t actual[300 + 8];
+    // Key at an odd address too, it is read out of the frame header
+    static const uint8_t keyBuffer[5] = { 0x00, 0x37, 0xA1, 0x5C, 0xE8 };
+    const uint8_t* key = keyBuffer + 1;
+
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t length = 0; length < 300; length++) {
+            for (size_t keyOffset = 0; keyOffset < 4; keyOffset++) {
+                for (size_t i = 0; i < sizeof(expected); i++) {
+                    expected[i] = actual[i] = (uint8_t)(i * 31 + length);
+                }
+                // The byte loop has no key offset: start it on a rotated key
+                uint8_t rotated[4];
+                for (size_t k = 0; k < 4; k++) {
+                    rotated[k] = key[(keyOffset + k) % 4];
+                }
+                maskBytes(expected + offset, length, rotated);
+                MaskAccess::maskPayload(actual + offset, length, key, keyOffset);
+                if (memcmp(expected, actual, sizeof(expected)) != 0) {
+                    out.printf("mismatch: offset %u, length %u, key offset %u\n", (unsigned)offset,
+                        (unsigned)length, (unsigned)keyOffset);
+                    return false;
+                }
+            }
+        }
+    }
+    out.printf("check: byte loop and maskPayload agree (offset 0..7, length 0..299, key offset 0..3)\n");
+    return true;
+}
+
+// ns per call, over enough calls to make micros() resolution negligible
+static double maskTime(bool words, uint8_t* data, size_t length, const uint8_t* key) {
+    const uint32_t calls = 2000000 / (length + 16);
+    unsigned long start = micros();
+    for (uint32_t i = 0; i < calls; i++) {
+        if (words) {
+            MaskAccess::maskPayload(data, length, key);
+        } else {
+            maskBytes(data, length, key);
+        }
+    }
+    unsigned long elapsed = micros() - start;
+    return elapsed * 1000.0 / calls;
+}
+
+bool maskBench(Print& out) {
+    if (!maskCheck(out)) {
+        return false;
+    }
+
+    static uint8_t buffer[1400 + 4];
+    static const uint8_t key[4] = { 0x37, 0xA1, 0x5C, 0xE8 };
+    static const size_t sizes[] = { 64, 256, 1400 };
+    memset(buffer, 0x5A, sizeof(buffer));
+
+    out.printf("%8s %12s %12s\n", "payload", "byte loop", "maskPayload");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        double bytes = maskTime(false, buffer + 1, sizes[i], key);
+        double words = maskTime(true, buffer + 1, sizes[i], key);
+        out.printf("%6u B %9.0f ns %9.0f ns  (%.1fx)\n", (unsigned)sizes[i], bytes, words, bytes / words);
+    }
+    return true;
+}
+
+#ifndef WEBSOCKETS_NATIVE
+// Board entry for the esp32dev-maskbench env
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    Serial.printf("Masking on %s at %u MHz\n", ESP.getChipModel(), (unsigned)getCpuFrequencyMhz());
+    maskBench(Serial);
+}
+
+void loop() {
+    delay(1000);
+}
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <Print.h>
+
+// WebSocket payload masking, old byte loop vs WebSockets::maskPayload().
+//
+// First checks that both give the same bytes for every start alignment,
+// length 0..299 and key offset, then times 64, 256 and 1400 byte payloads
+// starting at an odd address, like a payload behind a frame header. Plain
+// Arduino API, so the same code runs on the host (bench_main --mask) and on
+// the board (pio run -e esp32dev-maskbench -t upload -t monitor).
+//
+// Returns false if the two disagree anywhere.
+bool maskBench(Print& out);
@@ -0,0 +1,83 @@
+// WEBSOCKETS_NETWORK_TYPE == NETWORK_CUSTOM: the library's socket on top of
+// the host WiFiClient. There is no TLS on the host, so no secure variant.
+
+#include <WebSockets.h>
+#include <WebSocketsNetworkClient.h>
+
+struct WebSocketsNetworkClient::Impl {
+    WiFiClient tcp;
+};
+
+WebSocketsNetworkClient::WebSocketsNetworkClient() : _impl(new Impl()) {}
+
+WebSocketsNetworkClient::WebSocketsNetworkClient(WiFiClient wifi_client) : _impl(new Impl()) {
+    _impl->tcp = wifi_client;
+}
+
+WebSocketsNetworkClient::~WebSocketsNetworkClient() {}
+
+int WebSocketsNetworkClient::connect(IPAddress ip, uint16_t port) {
+    return connect(ip.toString().c_str(), port);
+}
+
+int WebSocketsNetworkClient::connect(const char* host, uint16_t port) {
+    return connect(host, port, WEBSOCKETS_TCP_TIMEOUT);
+}
+
+int WebSocketsNetworkClient::connect(const char* host, uint16_t port, int32_t timeout) {
+    if (!_impl->tcp.connect(host, port, timeout)) {
+        return 0;
+    }
+    // The library only does this itself for the ESP boards; without it
+    // Nagle would dominate every latency the bench measures.
+    _impl->tcp.setNoDelay(true);
+    return 1;
+}
+
+size_t WebSocketsNetworkClient::write(uint8_t c) {
+    return _impl->tcp.write(c);
+}
+
+size_t WebSocketsNetworkClient::write(const uint8_t* buf, size_t size) {
+    return _impl->tcp.write(buf, size);
+}
+
+size_t WebSocketsNetworkClient::write(const char* str) {
+    return _impl->tcp.write(str);
+}
+
+int WebSocketsNetworkClient::available() {
+    return _impl->tcp.available();
+}
+
+int WebSocketsNetworkClient::read() {
+    return _impl->tcp.read();
+}
+
+int WebSocketsNetworkClient::read(uint8_t* buf, size_t size) {
+    return _impl->tcp.read(buf, size);
+}
+
+int WebSocketsNetworkClient::peek() {
+    return _impl->tcp.peek();
+}
+
+void WebSocketsNetworkClient::flush() {
+    _impl->tcp.flush();
+}
+
+void WebSocketsNetworkClient::stop() {
+    _impl->tcp.stop();
+}
+
+uint8_t WebSocketsNetworkClient::connected() {
+    return _impl->tcp.connected();
+}
+
+WebSocketsNetworkClient::operator bool() {
+    return _impl->tcp.connected();
+}
+
+int WebSocketsNetworkClient::fd() const {
+    return _impl->tcp.fd();
+}
@@ -0,0 +1,55 @@
+#include <Preferences.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+bool Preferences::begin(const char* name, bool readOnly) {
+    const char* root = getenv("NVS_ROOT");
+    std::string dir = root ? root : ".pio/nvs";
+    mkdir(dir.c_str(), 0755);
+    _path = dir + "/" + name;
+    _readOnly = readOnly;
+    _values.clear();
+
+    FILE* file = fopen(_path.c_str(), "r");
+    if (file) {
+        char key[64];
+        unsigned long value;
+        while (fscanf(file, "%63s %lu", key, &value) == 2) {
+            _values[key] = (uint32_t)value;
+        }
+        fclose(file);
+    }
+    struct stat info;
+    return stat(dir.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+void Preferences::end() {
+    _path.clear();
+    _values.clear();
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+    auto it = _values.find(key);
+    return it != _values.end() ? it->second : defaultValue;
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+    if (_path.empty() || _readOnly) {
+        return 0;
+    }
+    _values[key] = value;
+    return save() ? sizeof(value) : 0;
+}
+
+bool Preferences::save() {
+    FILE* file = fopen(_path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    for (auto& entry : _values) {
+        fprintf(file, "%s %lu\n", entry.first.c_str(), (unsigned long)entry.second);
+    }
+    return fclose(file) == 0;
+}
@@ -0,0 +1,322 @@
+#include "radar_check.h"
+
+#include <string.h>
+
+#include "radar_protocol.h"
+#include "uart_framer.h"
+
+// ===== Reports =====
+// LD2450: AA FF 03 00 | 3 x 8 byte slots (x, y, speed sign-magnitude, gate
+// resolution) | 55 CC. LD2410: F4 F3 F2 F1 | length u16 | payload | F8 F7 F6 F5.
+
+// The example report in the LD2450 manual: x -782 mm, y 1713 mm, -16 cm/s
+static const uint8_t LD2450_ONE[] = {
+    0xAA, 0xFF, 0x03, 0x00,
+    0x0E, 0x03, 0xB1, 0x86, 0x10, 0x00, 0x40, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x55, 0xCC,
+};
+
+// (500, 1200, +20), (-1500, 3000, -35), (0, 250, 0)
+static const uint8_t LD2450_THREE[] = {
+    0xAA, 0xFF, 0x03, 0x00,
+    0xF4, 0x81, 0xB0, 0x84, 0x14, 0x80, 0x68, 0x01,
+    0xDC, 0x05, 0xB8, 0x8B, 0x23, 0x00, 0x68, 0x01,
+    0x00, 0x80, 0xFA, 0x80, 0x00, 0x80, 0x68, 0x01,
+    0x55, 0xCC,
+};
+
+static const uint8_t LD2450_EMPTY[] = {
+    0xAA, 0xFF, 0x03, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x55, 0xCC,
+};
+
+// Basic mode, moving target at 150 cm
+static const uint8_t LD2410_MOVING[] = {
+    0xF4, 0xF3, 0xF2, 0xF1, 0x0D, 0x00,
+    0x02, 0xAA, 0x01, 0x96, 0x00, 0x3C, 0x00, 0x00, 0x00, 0x96, 0x00, 0x55, 0x00,
+    0xF8, 0xF7, 0xF6, 0xF5,
+};
+
+// Basic mode, static target at 300 cm
+static const uint8_t LD2410_STATIC[] = {
+    0xF4, 0xF3, 0xF2, 0xF1, 0x0D, 0x00,
+    0x02, 0xAA, 0x02, 0x00, 0x00, 0x00, 0x2C, 0x01, 0x50, 0x2C, 0x01, 0x55, 0x00,
+    0xF8, 0xF7, 0xF6, 0xF5,
+};
+
+// Basic mode, nobody there
+static const uint8_t LD2410_NONE[] = {
+    0xF4, 0xF3, 0xF2, 0xF1, 0x0D, 0x00,
+    0x02, 0xAA, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x55, 0x00,
+    0xF8, 0xF7, 0xF6, 0xF5,
+};
+
+// Engineering mode, moving and static, moving target at 120 cm; per-gate
+// energies after the basic fields
+static const uint8_t LD2410_ENGINEERING[] = {
+    0xF4, 0xF3, 0xF2, 0xF1, 0x23, 0x00,
+    0x01, 0xAA, 0x03, 0x78, 0x00, 0x46, 0x2C, 0x01, 0x50, 0x78, 0x00,
+    0x08, 0x08,
+    0x10, 0x46, 0x30, 0x12, 0x08, 0x05, 0x04, 0x03, 0x02,
+    0x00, 0x00, 0x12, 0x50, 0x20, 0x10, 0x08, 0x06, 0x04,
+    0x00, 0x00,
+    0x55, 0x00,
+    0xF8, 0xF7, 0xF6, 0xF5,
+};
+
+struct Report {
+    const char* name;
+    const uint8_t* data;
+    size_t length;
+    uint8_t model;
+    uint8_t targetCount;
+    RadarTarget targets[RADAR_MAX_TARGETS];    // x, y, speed, distance
+};
+
+#define REPORT(data) #data, data, sizeof(data)
+
+static const Report REPORTS[] = {
+    { REPORT(LD2450_ONE), RADAR_MODEL_LD2450, 1, { { -782, 1713, -16, 1883 } } },
+    { REPORT(LD2450_THREE), RADAR_MODEL_LD2450, 3,
+        { { 500, 1200, 20, 1300 }, { -1500, 3000, -35, 3354 }, { 0, 250, 0, 250 } } },
+    { REPORT(LD2450_EMPTY), RADAR_MODEL_LD2450, 0, {} },
+    { REPORT(LD2410_MOVING), RADAR_MODEL_LD2410, 1, { { 0, 1500, 0, 1500 } } },
+    { REPORT(LD2410_STATIC), RADAR_MODEL_LD2410, 1, { { 0, 3000, 0, 3000 } } },
+    { REPORT(LD2410_NONE), RADAR_MODEL_LD2410, 0, {} },
+    { REPORT(LD2410_ENGINEERING), RADAR_MODEL_LD2410, 1, { { 0, 1200, 0, 1200 } } },
+};
+
+static const size_t REPORT_COUNT = sizeof(REPORTS) / sizeof(REPORTS[0]);
+
+static bool sameFrame(const Report& report, const TargetFrame& frame) {
+    if (frame.model != report.model || frame.targetCount != report.targetCount) {
+        return false;
+    }
+    for (uint8_t i = 0; i < report.targetCount; i++) {
+        const RadarTarget& a = frame.targets[i];
+        const RadarTarget& b = report.targets[i];
+        if (a.x != b.x || a.y != b.y || a.speed != b.speed || a.distance != b.distance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void printFrame(Print& out, const TargetFrame& frame) {
+    out.printf("  model %u, %u targets", (unsigned)frame.model, (unsigned)frame.targetCount);
+    for (uint8_t i = 0; i < frame.targetCount && i < RADAR_MAX_TARGETS; i++) {
+        const RadarTarget& t = frame.targets[i];
+        out.printf(" (%d, %d, %d, %u)", t.x, t.y, t.speed, (unsigned)t.distance);
+    }
+    out.printf("\n");
+}
+
+// ===== Sizing and decoding =====
+
+static bool checkSize(Print& out, const char* name, const uint8_t* data, size_t avail, int expected) {
+    int size = radarFrameSize(data, avail);
+    if (size != expected) {
+        out.printf("%s: radarFrameSize over %u bytes gave %d, expected %d\n", name, (unsigned)avail, size, expected);
+        return false;
+    }
+    return true;
+}
+
+static bool checkReports(Print& out) {
+    for (size_t i = 0; i < REPORT_COUNT; i++) {
+        const Report& report = REPORTS[i];
+        // The size is known once the header and length field are in
+        size_t known = report.model == RADAR_MODEL_LD2450 ? 4 : 6;
+        for (size_t avail = 1; avail <= report.length; avail++) {
+            int expected = avail < known ? UartFramer::FRAME_NEED_MORE : (int)report.length;
+            if (!checkSize(out, report.name, report.data, avail, expected)) {
+                return false;
+            }
+        }
+
+        TargetFrame frame;
+        RadarResult result = radarDecodeFrame(report.data, report.length, frame);
+        if (result != RADAR_OK || !sameFrame(report, frame)) {
+            out.printf("%s: decoded as %s\n", report.name, radarResultName(result));
+            printFrame(out, frame);
+            return false;
+        }
+    }
+    out.printf("check: %u reports sized from their header and decoded\n", (unsigned)REPORT_COUNT);
+    return true;
+}
+
+struct Rejection {
+    const char* name;
+    int at;           // byte to change, negative from the end
+    uint8_t value;
+    bool cut;         // drop the last byte instead
+    RadarResult expected;
+};
+
+static const Rejection REJECTIONS[] = {
+    { "LD2450 tail", -1, 0xCD, false, RADAR_BAD_TAIL },
+    { "LD2410 tail", -4, 0xF9, false, RADAR_BAD_TAIL },
+    { "LD2410 missing byte", 0, 0, true, RADAR_BAD_LENGTH },
+    { "LD2410 frame marker", 7, 0xAB, false, RADAR_BAD_PAYLOAD },
+    { "LD2410 end marker", -6, 0x56, false, RADAR_BAD_PAYLOAD },
+    { "LD2410 report type", 6, 0x03, false, RADAR_BAD_PAYLOAD },
+    { "header", 0, 0xAB, false, RADAR_BAD_HEADER },
+};
+
+static bool checkRejections(Print& out) {
+    uint8_t frame[64];
+    for (size_t i = 0; i < sizeof(REJECTIONS) / sizeof(REJECTIONS[0]); i++) {
+        const Rejection& bad = REJECTIONS[i];
+        const Report& report = strncmp(bad.name, "LD2450", 6) == 0 ? REPORTS[0] : REPORTS[3];
+        size_t length = report.length;
+        memcpy(frame, report.data, length);
+        if (bad.cut) {
+            length--;
+        } else {
+            frame[bad.at >= 0 ? bad.at : (int)length + bad.at] = bad.value;
+        }
+
+        TargetFrame decoded;
+        RadarResult result = radarDecodeFrame(frame, length, decoded);
+        if (result != bad.expected || decoded.targetCount != 0) {
+            out.printf("%s: decoded as %s, expected %s\n", bad.name, radarResultName(result),
+                radarResultName(bad.expected));
+            return false;
+        }
+    }
+
+    // Junk and lengths out of range are not frame starts at all
+    static const uint8_t JUNK[][6] = {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 'O', 'N', '\r', '\n', 0x00, 0x00 },
+        { 0xAA, 0x00, 0x03, 0x00, 0x00, 0x00 },
+        { 0xF4, 0xF3, 0xF2, 0xF1, 0x0C, 0x00 },    // payload shorter than 13
+        { 0xF4, 0xF3, 0xF2, 0xF1, 0x24, 0x00 },    // ... or longer than 35
+        { 0xF4, 0xF3, 0xF2, 0xF1, 0xFF, 0xFF },
+    };
+    for (size_t i = 0; i < sizeof(JUNK) / sizeof(JUNK[0]); i++) {
+        if (!checkSize(out, "junk", JUNK[i], sizeof(JUNK[i]), UartFramer::FRAME_NOT_BINARY)) {
+            return false;
+        }
+    }
+    out.printf("check: bad tail, length, payload and header rejected, junk not sized\n");
+    return true;
+}
+
+// ===== Resync through the framer =====
+
+#define CHECK_MAX_FRAMES 16
+
+struct FramerResults {
+    uint32_t count;
+    RadarResult results[CHECK_MAX_FRAMES];
+    TargetFrame frames[CHECK_MAX_FRAMES];
+};
+
+static void onFrame(const uint8_t* frame, size_t length, void* ctx) {
+    FramerResults& got = *(FramerResults*)ctx;
+    if (got.count < CHECK_MAX_FRAMES) {
+        got.results[got.count] = radarDecodeFrame(frame, length, got.frames[got.count]);
+    }
+    got.count++;
+}
+
+static void onLine(const uint8_t* frame, size_t length, void* ctx) {
+    (void)frame;
+    (void)length;
+    (void)ctx;
+}
+
+// Junk before the first report and between two, then an LD2450 report cut
+// short by a reset: its 30 bytes take the start of the LD2410 report after
+// it, which fails on its tail, and the rest of that report is skipped.
+static const uint8_t JUNK_START[] = { 0x00, 0xFF, 0x13, 0xAA, 0x00, 0xF4, 0xF3, 0x00 };
+static const uint8_t JUNK_HEADER[] = { 0xF4, 0xF3, 0xF2, 0xF1, 0xFF, 0x00 };    // length out of range
+
+struct Piece {
+    const uint8_t* data;
+    size_t length;
+    int report;      // index into REPORTS of the frame it yields; -1 none, -2 one that fails
+    RadarResult result;
+};
+
+static const Piece CAPTURE[] = {
+    { JUNK_START, sizeof(JUNK_START), -1, RADAR_OK },
+    { LD2450_ONE, sizeof(LD2450_ONE), 0, RADAR_OK },
+    { JUNK_HEADER, sizeof(JUNK_HEADER), -1, RADAR_OK },
+    { LD2410_MOVING, sizeof(LD2410_MOVING), 3, RADAR_OK },
+    { LD2450_THREE, 12, -1, RADAR_OK },
+    { LD2410_STATIC, sizeof(LD2410_STATIC), -2, RADAR_BAD_TAIL },
+    { LD2450_THREE, sizeof(LD2450_THREE), 1, RADAR_OK },
+    { LD2410_ENGINEERING, sizeof(LD2410_ENGINEERING), 6, RADAR_OK },
+    { LD2450_EMPTY, sizeof(LD2450_EMPTY), 2, RADAR_OK },
+    { LD2410_NONE, sizeof(LD2410_NONE), 5, RADAR_OK },
+};
+
+static const size_t CAPTURE_PIECES = sizeof(CAPTURE) / sizeof(CAPTURE[0]);
+
+static bool checkFramer(Print& out) {
+    static uint8_t capture[512];
+    size_t length = 0;
+    for (size_t i = 0; i < CAPTURE_PIECES; i++) {
+        memcpy(capture + length, CAPTURE[i].data, CAPTURE[i].length);
+        length += CAPTURE[i].length;
+    }
+
+    static const size_t chunks[] = { 1, 2, 5, 13, 64, sizeof(capture) };
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        static FramerResults got;
+        memset(&got, 0, sizeof(got));
+        UartFramer framer(onLine);
+        framer.setBinaryFraming(radarFrameSize, onFrame, &got);
+        for (size_t at = 0; at < length; at += chunks[c]) {
+            framer.feed(capture + at, length - at < chunks[c] ? length - at : chunks[c]);
+        }
+
+        uint32_t frame = 0;
+        for (size_t i = 0; i < CAPTURE_PIECES; i++) {
+            const Piece& piece = CAPTURE[i];
+            if (piece.report == -1) {
+                continue;
+            }
+            if (frame >= got.count) {
+                out.printf("chunks of %u: %u frames, more expected\n", (unsigned)chunks[c], (unsigned)got.count);
+                return false;
+            }
+            RadarResult result = got.results[frame];
+            bool same = piece.report < 0 || sameFrame(REPORTS[piece.report], got.frames[frame]);
+            if (result != piece.result || !same) {
+                out.printf("chunks of %u: frame %u decoded as %s, expected %s\n", (unsigned)chunks[c],
+                    (unsigned)frame, radarResultName(result), radarResultName(piece.result));
+                printFrame(out, got.frames[frame]);
+                return false;
+            }
+            frame++;
+        }
+        if (got.count != frame) {
+            out.printf("chunks of %u: %u frames, expected %u\n", (unsigned)chunks[c], (unsigned)got.count,
+                (unsigned)frame);
+            return false;
+        }
+        // every junk byte, plus what is left of the report that lost its start
+        uint32_t resyncs = sizeof(JUNK_START) + sizeof(JUNK_HEADER) + (sizeof(LD2410_STATIC) - 18);
+        if (framer.resyncs() != resyncs || framer.framesEmitted() != 0) {
+            out.printf("chunks of %u: %u bytes skipped and %u text lines, expected %u and 0\n", (unsigned)chunks[c],
+                (unsigned)framer.resyncs(), (unsigned)framer.framesEmitted(), (unsigned)resyncs);
+            return false;
+        }
+    }
+    out.printf("check: %u byte capture with junk and a cut report framed the same in chunks of 1..%u\n",
+        (unsigned)length, (unsigned)length);
+    return true;
+}
+
+bool radarCheck(Print& out) {
+    return checkReports(out) && checkRejections(out) && checkFramer(out);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <Print.h>
+
+// Radar frame check over byte-exact LD2450 and LD2410 reports.
+//
+// radarFrameSize() must size every report from its header (and length
+// field) alone, ask for more bytes on a prefix and refuse junk;
+// radarDecodeFrame() must give the expected targets and reject a bad tail,
+// a bad length and a bad payload. Then a capture with junk between reports
+// and a report cut short is run through UartFramer in chunks of several
+// sizes: every report after the junk has to come out, decoded the same way
+// whatever the chunking.
+//
+//   .pio/build/native/program --radar
+//
+// Returns false on the first mismatch, after printing it.
+bool radarCheck(Print& out);
@@ -0,0 +1,186 @@
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+WiFiClass WiFi;
+
+struct WiFiClient::Socket {
+    int fd;
+    explicit Socket(int fd) : fd(fd) {}
+    ~Socket() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+};
+
+WiFiClient::WiFiClient(int fd) {
+    if (fd >= 0) {
+        _socket = std::make_shared<Socket>(fd);
+    }
+}
+
+int WiFiClient::fd() const {
+    return _socket ? _socket->fd : -1;
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+    char host[16];
+    snprintf(host, sizeof(host), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    return connect(host, port);
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+    return connect(host, port, (int32_t)getTimeout());
+}
+
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeoutMs) {
+    stop();
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    if (getaddrinfo(host, service, &hints, &result) != 0 || !result) {
+        return 0;
+    }
+
+    int fd = ::socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(result);
+        return 0;
+    }
+
+    // Non-blocking from here on; connect() is bounded by the timeout
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int rc = ::connect(fd, result->ai_addr, result->ai_addrlen);
+    freeaddrinfo(result);
+    if (rc < 0 && errno == EINPROGRESS) {
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (poll(&pfd, 1, timeoutMs) == 1 && getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0) {
+            rc = 0;
+        }
+    }
+    if (rc < 0) {
+        ::close(fd);
+        return 0;
+    }
+
+    _socket = std::make_shared<Socket>(fd);
+    return 1;
+}
+
+// Blocks (up to the timeout) until everything is written, like the ESP32
+// client does with a full lwIP send buffer.
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+    if (!_socket) {
+        return 0;
+    }
+    size_t sent = 0;
+    unsigned long start = millis();
+    while (sent < size) {
+        ssize_t n = ::send(_socket->fd, buffer + sent, size - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            stop();
+            break;
+        }
+        if (millis() - start > getTimeout()) {
+            break;
+        }
+        struct pollfd pfd = { _socket->fd, POLLOUT, 0 };
+        poll(&pfd, 1, 10);
+    }
+    return sent;
+}
+
+int WiFiClient::available() {
+    if (!_socket) {
+        return 0;
+    }
+    int count = 0;
+    if (ioctl(_socket->fd, FIONREAD, &count) < 0) {
+        return 0;
+    }
+    return count;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+    if (!_socket) {
+        return -1;
+    }
+    ssize_t n = ::recv(_socket->fd, buffer, size, 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        stop();
+        return -1;
+    }
+    return n < 0 ? -1 : (int)n;
+}
+
+int WiFiClient::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::peek() {
+    uint8_t c;
+    if (!_socket || ::recv(_socket->fd, &c, 1, MSG_PEEK) != 1) {
+        return -1;
+    }
+    return c;
+}
+
+void WiFiClient::stop() {
+    _socket.reset();
+}
+
+// Connected until the peer closes and everything it sent has been read
+uint8_t WiFiClient::connected() {
+    if (!_socket) {
+        return 0;
+    }
+    if (available() > 0) {
+        return 1;
+    }
+    uint8_t c;
+    ssize_t n = ::recv(_socket->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+void WiFiClient::setNoDelay(bool noDelay) {
+    int flag = noDelay ? 1 : 0;
+    if (_socket) {
+        setsockopt(_socket->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    }
+}
+
+IPAddress WiFiClient::remoteIP() const {
+    struct sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    if (!_socket || getpeername(_socket->fd, (struct sockaddr*)&addr, &len) != 0) {
+        return IPAddress();
+    }
+    uint32_t ip = ntohl(addr.sin_addr.s_addr);
+    return IPAddress(ip >> 24, ip >> 16, ip >> 8, ip);
+}
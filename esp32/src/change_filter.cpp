@@ -0,0 +1,52 @@
+#include "change_filter.h"
+
+#include <string.h>
+
+static uint32_t difference(int32_t a, int32_t b) {
+    return (uint32_t)(a > b ? a - b : b - a);
+}
+
+void ChangeFilter::configure(uint16_t moveMm, uint32_t minIntervalMs, uint32_t keepaliveMs) {
+    _moveMm = moveMm;
+    _minIntervalMs = minIntervalMs;
+    _keepaliveMs = keepaliveMs;
+}
+
+ChangeFilter::Reason ChangeFilter::check(const TargetFrame& frame, uint32_t now) {
+    Reason reason = SUPPRESSED;
+    uint32_t since = now - _lastSentAt;
+
+    if (!_primed || frame.targetCount != _last.targetCount || frame.model != _last.model) {
+        reason = TRANSITION;
+        _transitions++;
+    } else if (_moveMm == 0 || (since >= _minIntervalMs && moved(frame))) {
+        reason = MOVED;
+        _moves++;
+    } else if (_keepaliveMs > 0 && since >= _keepaliveMs) {
+        reason = KEEPALIVE;
+        _keepalives++;
+    } else {
+        _suppressed++;
+        return SUPPRESSED;
+    }
+
+    memcpy(&_last, &frame, sizeof(_last));
+    _lastSentAt = now;
+    _primed = true;
+    return reason;
+}
+
+// Targets are compared slot by slot: the radar keeps a tracked person in
+// the same slot from report to report.
+bool ChangeFilter::moved(const TargetFrame& frame) const {
+    uint8_t count = frame.targetCount > RADAR_MAX_TARGETS ? RADAR_MAX_TARGETS : frame.targetCount;
+    for (uint8_t i = 0; i < count; i++) {
+        const RadarTarget& a = frame.targets[i];
+        const RadarTarget& b = _last.targets[i];
+        if (difference(a.x, b.x) > _moveMm || difference(a.y, b.y) > _moveMm ||
+            difference(a.distance, b.distance) > _moveMm) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "radar_protocol.h"
+
+// Change-only transmission for radar reports.
+//
+// The radar reports many times a second, and a person sitting still gives
+// the same target count and nearly the same positions every time. A report
+// passes only if
+//   - the target count changed (presence transitions included), always at once
+//   - a target moved more than `moveMm` in x, y or distance since the last
+//     report that passed, at most once per `minIntervalMs`
+//   - nothing passed for `keepaliveMs`, so the server still hears from a
+//     sensor whose room does not change
+// Everything else is dropped before it gets a seq, so it costs neither the
+// queue, the log nor the network anything.
+class ChangeFilter {
+  public:
+    enum Reason : uint8_t {
+        SUPPRESSED = 0,
+        TRANSITION,
+        MOVED,
+        KEEPALIVE,
+    };
+
+    // moveMm 0 passes every report, minIntervalMs notwithstanding;
+    // keepaliveMs 0 disables the keepalive.
+    void configure(uint16_t moveMm, uint32_t minIntervalMs, uint32_t keepaliveMs);
+
+    // Decides about one report; a report that passes becomes the reference
+    // the next ones are compared to.
+    Reason check(const TargetFrame& frame, uint32_t now);
+
+    uint32_t passed() const { return _transitions + _moves + _keepalives; }
+    uint32_t suppressed() const { return _suppressed; }
+    uint32_t transitions() const { return _transitions; }
+    uint32_t moves() const { return _moves; }
+    uint32_t keepalives() const { return _keepalives; }
+
+  private:
+    bool moved(const TargetFrame& frame) const;
+
+    uint16_t _moveMm = 150;
+    uint32_t _minIntervalMs = 100;
+    uint32_t _keepaliveMs = 2000;
+
+    bool _primed = false;
+    TargetFrame _last;
+    uint32_t _lastSentAt = 0;
+
+    uint32_t _suppressed = 0;
+    uint32_t _transitions = 0;
+    uint32_t _moves = 0;
+    uint32_t _keepalives = 0;
+};
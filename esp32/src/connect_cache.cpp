@@ -0,0 +1,82 @@
+#include "connect_cache.h"
+
+#include <WiFi.h>
+#include <string.h>
+
+#define CONNECT_CACHE_NAMESPACE "connect"
+
+void ConnectCache::begin() {
+    _open = _prefs.begin(CONNECT_CACHE_NAMESPACE, false);
+    if (!_open) {
+        return;
+    }
+
+    _channel = _prefs.getUChar("channel", 0);
+    if (_channel == 0 || _prefs.getBytes("bssid", _bssid, sizeof(_bssid)) != sizeof(_bssid)) {
+        _channel = 0;
+    }
+    _host = _prefs.getString("host", "");
+    _server = _prefs.getUInt("server", 0);
+}
+
+void ConnectCache::joinWiFi(const char* ssid, const char* password) {
+    _fastJoin = _channel != 0;
+    if (_fastJoin) {
+        WiFi.begin(ssid, password, _channel, _bssid);
+    } else {
+        WiFi.begin(ssid, password);
+    }
+}
+
+void ConnectCache::wifiConnected() {
+    _fastJoin = false;
+
+    const uint8_t* bssid = WiFi.BSSID();
+    uint8_t channel = (uint8_t)WiFi.channel();
+    if (!bssid || (channel == _channel && memcmp(bssid, _bssid, sizeof(_bssid)) == 0)) {
+        return;
+    }
+
+    memcpy(_bssid, bssid, sizeof(_bssid));
+    _channel = channel;
+    if (_open) {
+        _prefs.putBytes("bssid", _bssid, sizeof(_bssid));
+        _prefs.putUChar("channel", _channel);
+    }
+}
+
+void ConnectCache::forgetAccessPoint() {
+    _channel = 0;
+    _fastJoin = false;
+    if (_open) {
+        _prefs.remove("channel");
+    }
+}
+
+String ConnectCache::serverAddress(const char* host) {
+    IPAddress ip;
+    if (!ip.fromString(host) && _server != 0 && _host == host) {
+        return IPAddress(_server).toString();
+    }
+    return String(host);
+}
+
+bool ConnectCache::resolveServer(const char* host) {
+    IPAddress ip;
+    if (ip.fromString(host) || !WiFi.hostByName(host, ip)) {
+        return false;
+    }
+
+    uint32_t server = (uint32_t)ip;
+    if (server == _server && _host == host) {
+        return false;
+    }
+
+    _server = server;
+    _host = host;
+    if (_open) {
+        _prefs.putString("host", _host);
+        _prefs.putUInt("server", _server);
+    }
+    return true;
+}
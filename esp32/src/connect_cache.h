@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <Preferences.h>
+
+// Boot-time shortcuts for the network task, kept in NVS across resets:
+//   - the access point (BSSID and channel) of the last association, so
+//     WiFi.begin() joins it directly instead of scanning every channel
+//   - the address the server's host name resolved to, so the first
+//     connection needs no DNS lookup
+// Both are only hints: the caller falls back to a scan when a fast join
+// does not complete, and resolves the name again when the cached address
+// does not answer. NVS is only written when something changed.
+class ConnectCache {
+  public:
+    void begin();
+
+    // Starts the association, on the cached access point if there is one.
+    // Returns right away; the caller polls WiFi.status().
+    void joinWiFi(const char* ssid, const char* password);
+    // A join on the cached access point is pending
+    bool fastJoin() const { return _fastJoin; }
+
+    // Remembers the access point of the association that just completed
+    void wifiConnected();
+    // The cached access point did not answer: scan on the next join
+    void forgetAccessPoint();
+
+    // host itself for an IP literal, else the cached address of host if
+    // there is one, else host (resolved by the WebSocket client)
+    String serverAddress(const char* host);
+    // Resolves host and caches the result; true if the address changed.
+    // Does nothing for IP literals.
+    bool resolveServer(const char* host);
+
+  private:
+    Preferences _prefs;
+    bool _open = false;
+
+    uint8_t _bssid[6] = {0};
+    uint8_t _channel = 0;
+    bool _fastJoin = false;
+
+    String _host;
+    uint32_t _server = 0;
+};
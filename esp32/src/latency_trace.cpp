@@ -0,0 +1,63 @@
+#include "latency_trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+size_t LatencyTrace::formatPacket(char* out, size_t capacity, const char* sensorId,
+                                  const uint8_t* packet, size_t length, uint32_t sentUs) const {
+    uint32_t seqs[16];
+    size_t count = telemetryPacketSeqs(packet, length, seqs, sizeof(seqs) / sizeof(seqs[0]));
+
+    int n = snprintf(out, capacity, "{\"type\":\"trace\",\"sensorId\":\"%s\",\"sent\":%lu,\"samples\":[",
+        sensorId, (unsigned long)sentUs);
+    if (n < 0 || (size_t)n >= capacity) {
+        return 0;
+    }
+    size_t len = (size_t)n;
+
+    size_t traced = 0;
+    for (size_t i = 0; i < count; i++) {
+        const SampleTrace& t = _traces[seqs[i] % LATENCY_TRACE_DEPTH];
+        if (t.seq != seqs[i] || seqs[i] == 0 || seqs[i] % LATENCY_TRACE_EVERY != 0) {
+            continue;
+        }
+        n = snprintf(out + len, capacity - len, "%s[%lu,%lu,%lu]", traced ? "," : "",
+            (unsigned long)t.seq, (unsigned long)t.frameUs, (unsigned long)t.queuedUs);
+        if (n < 0 || (size_t)n >= capacity - len) {
+            return 0;
+        }
+        len += (size_t)n;
+        traced++;
+    }
+
+    if (traced == 0 || capacity - len < 3) {
+        return 0;
+    }
+    out[len++] = ']';
+    out[len++] = '}';
+    out[len] = '\0';
+    return len;
+}
+
+size_t LatencyTrace::formatClockReply(char* out, size_t capacity, const char* sensorId,
+                                      const char* heartbeat, uint32_t rxUs, uint32_t txUs) {
+    // The server's timestamp goes back verbatim, so no float parsing here
+    const char* mono = strstr(heartbeat, "\"mono\":");
+    if (!mono) {
+        return 0;
+    }
+    mono += 7;
+    size_t monoLength = strspn(mono, "0123456789.");
+    if (monoLength == 0 || monoLength > 24) {
+        return 0;
+    }
+
+    int n = snprintf(out, capacity, "{\"type\":\"clock\",\"sensorId\":\"%s\",\"t1\":%.*s,\"t2\":%lu,\"t3\":%lu}",
+        sensorId, (int)monoLength, mono, (unsigned long)rxUs, (unsigned long)txUs);
+    if (n < 0 || (size_t)n >= capacity) {
+        return 0;
+    }
+    return (size_t)n;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Keep the trace of this many recent samples; older ones are not reported.
+#ifndef LATENCY_TRACE_DEPTH
+#define LATENCY_TRACE_DEPTH 64
+#endif
+
+// Only seqs divisible by this are traced, the same rule as the server's
+// LATENCY_TRACE_EVERY, so device and dashboards report the same samples.
+#ifndef LATENCY_TRACE_EVERY
+#define LATENCY_TRACE_EVERY 32
+#endif
+
+// Device stages of one sample, in micros() of this board.
+struct SampleTrace {
+    uint32_t seq;
+    uint32_t frameUs;     // radar frame complete (framer callback)
+    uint32_t queuedUs;    // pushed to the network side
+};
+
+// Device half of the end-to-end latency trace (see raspberry-pi/server/latency.js).
+//
+// After every live telemetry packet that holds a traced seq, the network
+// side sends
+//   {"type":"trace","sensorId":"sensor1","sent":<us>,"samples":[[seq,frameUs,queuedUs],...]}
+// with `sent` taken right after sendBIN() returned. The server maps these
+// onto its own clock with the offset measured over the heartbeat: every
+// {"type":"heartbeat","mono":<ms>} it sends is answered with
+//   {"type":"clock","sensorId":"sensor1","t1":<mono>,"t2":<rx us>,"t3":<tx us>}
+//
+// Not thread-safe: owned by the network side.
+class LatencyTrace {
+  public:
+    void record(const SampleTrace& trace) { _traces[trace.seq % LATENCY_TRACE_DEPTH] = trace; }
+
+    // Trace message for the traced samples of a packet built by
+    // TelemetryWriter. Returns 0 if there are none or `capacity` is too small.
+    size_t formatPacket(char* out, size_t capacity, const char* sensorId,
+                        const uint8_t* packet, size_t length, uint32_t sentUs) const;
+
+    // Reply to a server heartbeat; 0 if `heartbeat` carries no "mono".
+    static size_t formatClockReply(char* out, size_t capacity, const char* sensorId,
+                                   const char* heartbeat, uint32_t rxUs, uint32_t txUs);
+
+  private:
+    SampleTrace _traces[LATENCY_TRACE_DEPTH] = {};
+};
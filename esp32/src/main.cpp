@@ -2,6 +2,9 @@
 #include <WiFi.h>
 #include <WebSocketsClient.h>
 
+#include "connect_cache.h"
+#include "pipeline.h"
+
 #define RX_PIN 16
 #define TX_PIN 17
 
@@ -14,9 +17,45 @@ const char* wsHost = "172.20.10.2";  // ← Change to your PC's IP on same Wi-Fi
 const uint16_t wsPort = 3000;
 const char* wsPath = "/ws";
 
+// Fast rejoin: a join on the cached access point that has not completed
+// after fastJoinTimeoutMs falls back to a scan; a server that has not
+// answered serverCheckMs after the association gets its name resolved again
+const unsigned long fastJoinTimeoutMs = 2000;
+const unsigned long serverCheckMs = 3000;
+
 WebSocketsClient webSocket;
 HardwareSerial mmwaveSerial(2);
 
+// Telemetry (format and batching: see pipeline.cpp)
+const char* sensorId = "sensor1";
+
+Pipeline pipeline(webSocket, sensorId);
+ConnectCache connectCache;
+unsigned long joinStartedAt = 0;    // last WiFi.begin(), for the fast join timeout
+
+// ===== Tasks =====
+// The sensor task owns the UART and never touches the network; the network
+// task owns Wi-Fi and the WebSocket. They only share the queues below, so a
+// reconnect or a slow TCP write cannot delay sampling.
+#if CONFIG_FREERTOS_UNICORE
+#define SENSOR_TASK_CORE 0
+#define NETWORK_TASK_CORE 0
+#else
+#define SENSOR_TASK_CORE 1     // app core, away from the Wi-Fi stack
+#define NETWORK_TASK_CORE 0    // protocol core, next to Wi-Fi / lwIP
+#endif
+
+const UBaseType_t sensorTaskPriority = 5;
+const UBaseType_t networkTaskPriority = 2;
+const TickType_t sensorPeriod = pdMS_TO_TICKS(2);    // UART FIFO holds ~20 ms at 115200
+
+TaskHandle_t networkTaskHandle = nullptr;
+
+// Called from the sensor task whenever it queued something
+void notifyNetworkTask(void* ctx) {
+    xTaskNotifyGive(networkTaskHandle);
+}
+
 void onWebSocketEvent(WStype_t type, uint8_t* payload, size_t length) {
     switch (type) {
         case WStype_CONNECTED:
@@ -25,121 +64,141 @@ void onWebSocketEvent(WStype_t type, uint8_t* payload, size_t length) {
         case WStype_DISCONNECTED:
             Serial.println("✗ WebSocket disconnected");
             break;
-        case WStype_TEXT:
-            Serial.printf("← Server: %s\n", payload);
+        case WStype_TX_HIGH_WATER:
+            Serial.printf("⚠ WebSocket send queue backed up (%u bytes), holding samples\n", (unsigned)length);
             break;
         default:
             break;
     }
+
+    // Acks and reconnect replay
+    if (!pipeline.handleEvent(type, payload, length) && type == WStype_TEXT) {
+        Serial.printf("← Server: %s\n", payload);
+    }
 }
 
-void setup() {
-    Serial.begin(115200);
-    delay(2000);
-    
-    mmwaveSerial.begin(115200, SERIAL_8N1, 16, 17);
-    
-    Serial.println("\n=================================");
-    Serial.println("ESP32 WiFi (WPA2-PSK) Connection");
-    Serial.println("=================================");
-    
-    // Reset WiFi
-    WiFi.disconnect(true);
-    WiFi.mode(WIFI_OFF);
-    delay(500);
-    WiFi.mode(WIFI_STA);
-    delay(500);
-    
-    Serial.print("Connecting to: ");
-    Serial.println(ssid);
-    
-    // Simple WPA2-PSK connect (no EAP)
-    WiFi.begin(ssid, password);
-    
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 30) {
-        delay(1000);
-        Serial.print(".");
-        attempts++;
-        
-        if (attempts % 10 == 0) {
-            Serial.println();
-            Serial.print("Status (");
-            Serial.print(attempts);
-            Serial.print("s): ");
-            switch(WiFi.status()) {
-                case WL_NO_SSID_AVAIL:
-                    Serial.println("Can't find network");
-                    break;
-                case WL_CONNECT_FAILED:
-                    Serial.println("Connection failed - check password");
-                    break;
-                case WL_DISCONNECTED:
-                    Serial.println("Disconnected");
-                    break;
-                default:
-                    Serial.println(WiFi.status());
-            }
-            Serial.print("Retrying");
-        }
+void sensorTask(void* arg) {
+    TickType_t lastWake = xTaskGetTickCount();
+    for (;;) {
+        pipeline.pollSensor(mmwaveSerial);
+        vTaskDelayUntil(&lastWake, sensorPeriod);
     }
-    
-    Serial.println();
-    
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("\n✓✓✓ SUCCESS ✓✓✓");
-        Serial.print("IP: ");
-        Serial.println(WiFi.localIP());
-        Serial.print("Signal: ");
-        Serial.print(WiFi.RSSI());
-        Serial.println(" dBm");
-        Serial.print("MAC: ");
-        Serial.println(WiFi.macAddress());
-        
-        // Initialize WebSocket
-        webSocket.begin(wsHost, wsPort, wsPath);
-        webSocket.onEvent(onWebSocketEvent);
-        webSocket.setReconnectInterval(5000);
-        webSocket.enableHeartbeat(15000, 3000, 2);
-        Serial.println("✓ WebSocket ready");
-        
-    } else {
-        Serial.println("\n✗ FAILED to connect");
-        Serial.println("\nCheck:");
-        Serial.println("  - SSID is correct");
-        Serial.println("  - Password is correct");
-        Serial.println("  - Wi-Fi is in range");
-        Serial.print("\nYour MAC: ");
-        Serial.println(WiFi.macAddress());
+}
+
+// Prints why the association has not completed yet
+void printWiFiStatus() {
+    switch (WiFi.status()) {
+        case WL_NO_SSID_AVAIL:
+            Serial.println("WiFi: can't find network");
+            break;
+        case WL_CONNECT_FAILED:
+            Serial.println("WiFi: connection failed - check password");
+            break;
+        default:
+            Serial.printf("WiFi: not connected (status %d)\n", (int)WiFi.status());
+            break;
     }
 }
 
-void loop() {
-    webSocket.loop();
-    
-    static unsigned long lastCheck = 0;
-    if (millis() - lastCheck > 10000) {
-        lastCheck = millis();
-        if (WiFi.status() != WL_CONNECTED) {
-            Serial.println("WiFi disconnected, reconnecting...");
-            WiFi.begin(ssid, password);
+void networkTask(void* arg) {
+    unsigned long lastCheck = millis();
+    bool online = false;
+    unsigned long onlineAt = 0;
+    bool serverChecked = false;
+
+    for (;;) {
+        if (WiFi.status() == WL_CONNECTED) {
+            if (!online) {
+                online = true;
+                onlineAt = millis();
+                serverChecked = false;
+                connectCache.wifiConnected();
+                Serial.printf("✓ WiFi connected after %lu ms: IP %s, %d dBm\n",
+                              millis() - joinStartedAt, WiFi.localIP().toString().c_str(), WiFi.RSSI());
+            }
+
+            // Not before the association: a connect that fails for lack of
+            // Wi-Fi would cost a whole reconnect interval
+            webSocket.loop();
+
+            // Once per association: a cached server address that does not
+            // answer is resolved again, one reached by name is cached for
+            // the next boot
+            if (!serverChecked && (webSocket.isConnected() || millis() - onlineAt > serverCheckMs)) {
+                serverChecked = true;
+                if (connectCache.resolveServer(wsHost) && !webSocket.isConnected()) {
+                    String address = connectCache.serverAddress(wsHost);
+                    Serial.printf("Server %s moved to %s\n", wsHost, address.c_str());
+                    webSocket.begin(address.c_str(), wsPort, wsPath);
+                }
+            }
+        } else {
+            if (online) {
+                online = false;
+                joinStartedAt = millis();
+                Serial.println("✗ WiFi lost");
+            } else if (connectCache.fastJoin() && millis() - joinStartedAt > fastJoinTimeoutMs) {
+                Serial.println("Last access point did not answer, scanning");
+                connectCache.forgetAccessPoint();
+                connectCache.joinWiFi(ssid, password);
+                joinStartedAt = millis();
+            }
         }
-    }
-    
-    // Read mmWave sensor data
-    if (mmwaveSerial.available()) {
-        String sensorData = mmwaveSerial.readStringUntil('\n');
-        sensorData.trim();
-        
-        if (sensorData.length() > 0) {
-            String json = "{\"sensorId\":\"sensor1\",\"raw\":\"" + sensorData + "\"}";
-            Serial.println("→ " + json);
-            
-            if (webSocket.isConnected()) {
-                webSocket.sendTXT(json);
+
+        if (millis() - lastCheck > 10000) {
+            lastCheck = millis();
+            if (WiFi.status() != WL_CONNECTED && millis() - joinStartedAt > 10000) {
+                printWiFiStatus();
+                Serial.println("WiFi disconnected, reconnecting...");
+                connectCache.joinWiFi(ssid, password);
+                joinStartedAt = millis();
             }
+            pipeline.printStats(Serial);
         }
+
+        pipeline.pollNetwork();
+
+        // Woken early by the sensor task; the timeout keeps the socket and
+        // the batch window ticking when the sensor is quiet.
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
     }
-    
-    delay(10);
-}
\ No newline at end of file
+}
+
+// Nothing here waits for the network: Wi-Fi associates in the background
+// while the sample log is restored, and the sensor task samples from the
+// start. The network task connects the WebSocket as soon as there is an IP.
+void setup() {
+    Serial.begin(115200);
+
+    mmwaveSerial.begin(115200, SERIAL_8N1, RX_PIN, TX_PIN);
+
+    // No Wi-Fi config written to flash on every begin(); the access point
+    // to rejoin comes from the connect cache
+    WiFi.persistent(false);
+    WiFi.mode(WIFI_STA);
+    connectCache.begin();
+    connectCache.joinWiFi(ssid, password);
+    joinStartedAt = millis();
+    Serial.printf("Connecting to %s%s\n", ssid, connectCache.fastJoin() ? " (last access point)" : "");
+
+    // Restores samples that were still unacked at the last reset
+    if (pipeline.begin(notifyNetworkTask)) {
+        Serial.printf("Sample log: %lu samples restored\n", (unsigned long)pipeline.log().size());
+    } else {
+        Serial.println("Sample log: no flash, RAM only");
+    }
+
+    webSocket.begin(connectCache.serverAddress(wsHost).c_str(), wsPort, wsPath);
+    webSocket.onEvent(onWebSocketEvent);
+    webSocket.setReconnectInterval(5000);
+    webSocket.enableHeartbeat(15000, 3000, 2);
+
+    // Network first: the sensor task notifies it
+    xTaskCreatePinnedToCore(networkTask, "network", 8192, nullptr, networkTaskPriority, &networkTaskHandle, NETWORK_TASK_CORE);
+    xTaskCreatePinnedToCore(sensorTask, "sensor", 4096, nullptr, sensorTaskPriority, nullptr, SENSOR_TASK_CORE);
+}
+
+void loop() {
+    // Everything runs in sensorTask / networkTask
+    vTaskDelete(nullptr);
+}
@@ -0,0 +1,339 @@
+#include "pipeline.h"
+
+#include "radar_protocol.h"
+
+// Binary samples are coalesced into one frame per batch (flushed early on
+// any presence change). 1 sample disables batching.
+static const uint8_t batchMaxSamples = 8;
+static const uint32_t batchWindowMs = 250;
+
+// Change-only transmission (see change_filter.h): a report goes out at once
+// when the target count changes, when a target moved more than
+// changeMoveMm (at most every changeMinIntervalMs), and otherwise every
+// keepaliveMs. Set changeMoveMm to 0 to send every report.
+static const uint16_t changeMoveMm = 150;
+static const uint32_t changeMinIntervalMs = 100;
+static const uint32_t keepaliveMs = 2000;
+
+// Store-and-forward: every sample stays in the log until the server acks
+// its seq. After an outage the backlog is replayed at most replayRate
+// samples/s (live traffic is far below that), and anything unacked for
+// ackTimeoutMs is sent again. Samples older than liveAgeMs go out flagged
+// as replay so the server files them as history.
+static const uint32_t replayRate = 100;
+static const uint32_t replayBurst = 16;
+static const uint32_t ackTimeoutMs = 5000;
+static const uint32_t liveAgeMs = 1000;
+
+// Seqs are never issued twice, also across resets with an empty log: the
+// network side keeps a block of them reserved in NVS ahead of the newest
+// one, and a reset carries on past the reservation. One NVS write per
+// seqReserveBlock / 2 samples.
+static const uint32_t seqReserveBlock = 1024;
+
+Pipeline::Pipeline(WebSocketsClient& socket, const char* sensorId)
+    : _socket(socket),
+      _sensorId(sensorId),
+      _framer(onSensorLine, this),
+      _batcher(sensorId, sendTelemetry, this) {}
+
+bool Pipeline::begin(Notify notify, void* ctx) {
+    _notify = notify;
+    _notifyCtx = ctx;
+
+    _framer.setBinaryFraming(radarFrameSize, onSensorFrame, this);
+    _batcher.configure(batchMaxSamples, batchWindowMs);
+    _changes.configure(changeMoveMm, changeMinIntervalMs, keepaliveMs);
+
+    // Restore samples that were still unacked at the last reset
+    bool spill = _log.begin();
+    _prefs.begin("pipeline", false);
+    _seq = _prefs.getUInt("seq", 0);
+    if (_seq < _log.lastSeq()) {
+        _seq = _log.lastSeq();
+    }
+    _firstSeq = _seq + 1;
+    reserveSeqs(_seq);
+    _prevFirstSeq = _prefs.getUInt("boot", 0);
+    _prefs.putUInt("boot", _firstSeq);
+    return spill;
+}
+
+void Pipeline::reserveSeqs(uint32_t seq) {
+    _seqReserved = seq + seqReserveBlock;
+    _prefs.putUInt("seq", _seqReserved);
+}
+
+void Pipeline::setHooks(SampleHook sample, PacketHook packet, void* ctx) {
+    _sampleHook = sample;
+    _packetHook = packet;
+    _hookCtx = ctx;
+}
+
+// ----- Sensor side -----
+
+void Pipeline::pollSensor(Stream& uart) {
+    // Drains the UART, never waits for a full line
+    _framer.poll(uart);
+}
+
+// Called by the framer for every complete, trimmed sensor line
+void Pipeline::onSensorLine(const uint8_t* line, size_t length, void* ctx) {
+    Pipeline* self = (Pipeline*)ctx;
+    SensorLine record;
+    record.length = (uint8_t)length;
+    memcpy(record.text, line, length);
+    record.text[length] = '\0';
+
+    if (self->_lines.push(record) && self->_notify) {
+        self->_notify(self->_notifyCtx);
+    }
+}
+
+// Called by the framer for every binary radar report
+void Pipeline::onSensorFrame(const uint8_t* frame, size_t length, void* ctx) {
+    Pipeline* self = (Pipeline*)ctx;
+    QueuedSample queued;
+    queued.frameUs = micros();
+
+    PresenceSample& sample = queued.sample;
+    RadarResult result = radarDecodeFrame(frame, length, sample.frame);
+    if (result != RADAR_OK) {
+        // Counted only: printing here would stall the sensor task on the UART
+        self->_rejected[result]++;
+        return;
+    }
+    uint32_t now = millis();
+    if (self->_changes.check(sample.frame, now) == ChangeFilter::SUPPRESSED) {
+        return;
+    }
+    sample.seq = ++self->_seq;
+    sample.timestamp = now;
+
+    if (self->_sampleHook) {
+        self->_sampleHook(sample, self->_hookCtx);
+    }
+    queued.queuedUs = micros();
+    if (self->_samples.push(queued) && self->_notify) {
+        self->_notify(self->_notifyCtx);
+    }
+}
+
+// ----- Network side -----
+
+void Pipeline::pollNetwork() {
+    QueuedSample queued;
+    while (_samples.pop(queued)) {
+        if (queued.sample.seq + seqReserveBlock / 2 > _seqReserved) {
+            reserveSeqs(queued.sample.seq);
+        }
+        _log.append(queued.sample);
+        SampleTrace trace = { queued.sample.seq, queued.frameUs, queued.queuedUs };
+        _trace.record(trace);
+    }
+    _log.poll(millis());
+    sendFromLog();
+    SensorLine line;
+    while (_lines.pop(line)) {
+        sendSensorLine(line);
+    }
+    _batcher.poll(millis());
+}
+
+bool Pipeline::sendTelemetry(const uint8_t* data, size_t length, void* ctx) {
+    Pipeline* self = (Pipeline*)ctx;
+    if (!self->_socket.isConnected() || !self->_socket.sendBIN(data, length)) {
+        // The batcher drops the packet: its samples go out again from the log
+        self->_log.rewind();
+        return false;
+    }
+#if LATENCY_TRACE
+    uint32_t sentUs = micros();
+#endif
+    if (self->_packetHook) {
+        self->_packetHook(data, length, self->_hookCtx);
+    }
+#if LATENCY_TRACE
+    // Backlog latency is the outage, not the pipeline
+    if (!(data[2] & TELEMETRY_FLAG_REPLAY)) {
+        self->sendTrace(data, length, sentUs);
+    }
+#endif
+    return true;
+}
+
+void Pipeline::sendTrace(const uint8_t* packet, size_t length, uint32_t sentUs) {
+    size_t capacity = 0;
+    char* out = (char*)_socket.getTxBuffer(capacity);
+    if (out) {
+        _socket.commitTXT(_trace.formatPacket(out, capacity, _sensorId, packet, length, sentUs));
+    }
+}
+
+// JSON goes straight into the socket's reserved tx buffer, so sending it
+// neither allocates nor copies. While the send queue is backed up lines are
+// only echoed: queueing them would push telemetry out of the queue.
+void Pipeline::sendSensorLine(const SensorLine& line) {
+    if (_congested) {
+        _linesSkipped++;
+    }
+    if (!_socket.isConnected() || _congested) {
+        if (telemetryFormatRawLine(_jsonBuffer, sizeof(_jsonBuffer), _sensorId, line.text, line.length) > 0) {
+            Serial.printf("→ %s\n", _jsonBuffer);
+        }
+        return;
+    }
+
+    size_t capacity = 0;
+    char* out = (char*)_socket.getTxBuffer(capacity);
+    if (!out) {
+        return;
+    }
+    size_t len = telemetryFormatRawLine(out, capacity, _sensorId, line.text, line.length);
+    if (len > 0) {
+        Serial.printf("→ %s\n", out);
+    }
+    _socket.commitTXT(len);
+}
+
+void Pipeline::sendSample(const PresenceSample& sample, bool replay, uint32_t prevSeq) {
+#if TELEMETRY_BINARY
+    _batcher.add(sample, millis(), replay, prevSeq);
+#else
+    (void)replay;    // the JSON form carries seq/ts only
+    if (!_socket.isConnected()) {
+        return;
+    }
+    size_t capacity = 0;
+    char* out = (char*)_socket.getTxBuffer(capacity);
+    if (!out || !_socket.commitTXT(telemetryFormatJson(out, capacity, _sensorId, sample, prevSeq))) {
+        _log.rewind();
+    }
+#endif
+}
+
+// Hands logged samples to the sender, paced by a token bucket (in
+// thousandths of a sample).
+void Pipeline::sendFromLog() {
+    uint32_t now = millis();
+    uint32_t elapsed = now - _lastRefill;
+    _lastRefill = now;
+    _credit += (elapsed > 1000 ? 1000 : elapsed) * replayRate;
+    if (_credit > replayBurst * 1000) {
+        _credit = replayBurst * 1000;
+    }
+
+    if (!_socket.isConnected()) {
+        return;
+    }
+    if (_congested) {
+        // The socket's send queue is backed up: samples wait here, where
+        // nothing is dropped, and acks are not expected meanwhile
+        _lastAckAt = now;
+        return;
+    }
+    if (_log.inFlight() == 0) {
+        _lastAckAt = now;
+    } else if (now - _lastAckAt > ackTimeoutMs) {
+        Serial.printf("No ack for %lu samples, resending\n", (unsigned long)_log.inFlight());
+        _log.rewind();
+        _lastAckAt = now;
+    }
+
+    PresenceSample sample;
+    uint32_t prevSeq;
+    while (_credit >= 1000 && _log.next(sample, prevSeq)) {
+        _credit -= 1000;
+        sendSample(sample, now - sample.timestamp > liveAgeMs, prevSeq);
+    }
+}
+
+// {"type":"ack","seq":N} from the server: everything up to N arrived. An
+// ack that does not move on (the server is missing a packet before the
+// ones it got) does not count, so the ack timeout resends the gap.
+bool Pipeline::handleServerAck(const char* text) {
+    if (!strstr(text, "\"type\":\"ack\"")) {
+        return false;
+    }
+    const char* seq = strstr(text, "\"seq\":");
+    if (seq && _log.ack(strtoul(seq + 6, nullptr, 10))) {
+        _lastAckAt = millis();
+    }
+    return true;
+}
+
+// Sample timestamps are millis() of the boot they were taken in, which the
+// server maps to wall time per boot; seqs tell it which boot a sample is from.
+void Pipeline::sendHello() {
+    size_t capacity = 0;
+    char* out = (char*)_socket.getTxBuffer(capacity);
+    if (out) {
+        _socket.commitTXT(telemetryFormatHello(out, capacity, _sensorId, _firstSeq, _prevFirstSeq, millis()));
+    }
+}
+
+// {"type":"heartbeat","mono":<ms>} from the server: answer at once so it
+// can work out this board's clock offset
+bool Pipeline::handleHeartbeat(const char* text, uint32_t rxUs) {
+    if (!strstr(text, "\"type\":\"heartbeat\"")) {
+        return false;
+    }
+#if LATENCY_TRACE
+    size_t capacity = 0;
+    char* out = (char*)_socket.getTxBuffer(capacity);
+    if (out) {
+        _socket.commitTXT(LatencyTrace::formatClockReply(out, capacity, _sensorId, text, rxUs, micros()));
+    }
+#endif
+    return true;
+}
+
+bool Pipeline::handleEvent(WStype_t type, const uint8_t* payload, size_t length) {
+    uint32_t rxUs = micros();
+    switch (type) {
+        case WStype_CONNECTED:
+            if (_log.size() > 0) {
+                Serial.printf("Replaying %lu logged samples\n", (unsigned long)_log.size());
+            }
+            _log.rewind();
+            _congested = false;
+            sendHello();
+            return false;
+        case WStype_DISCONNECTED:
+            // Whatever is unacked now may wait a long time: keep it across a reset
+            _log.flush();
+            return false;
+        case WStype_TX_HIGH_WATER:
+            _congested = true;
+            _congestions++;
+            return true;
+        case WStype_TX_LOW_WATER:
+            _congested = false;
+            return true;
+        case WStype_TEXT:
+            return handleServerAck((const char*)payload) || handleHeartbeat((const char*)payload, rxUs);
+        default:
+            return false;
+    }
+}
+
+void Pipeline::printStats(Print& out) const {
+    out.printf("Queue: %u/%u (max %lu), dropped %lu samples, %lu lines\n",
+        (unsigned)_samples.depth(), (unsigned)_samples.capacity(), (unsigned long)_samples.highWater(),
+        (unsigned long)_samples.drops(), (unsigned long)_lines.drops());
+    out.printf("Log: %lu unacked (%lu in flash), %lu lost\n",
+        (unsigned long)_log.size(), (unsigned long)_log.spilled(), (unsigned long)_log.lost());
+    out.printf("Changes: %lu reports sent (%lu transitions, %lu moves, %lu keepalives), %lu suppressed\n",
+        (unsigned long)_changes.passed(), (unsigned long)_changes.transitions(), (unsigned long)_changes.moves(),
+        (unsigned long)_changes.keepalives(), (unsigned long)_changes.suppressed());
+    out.print("Radar frames rejected:");
+    for (uint8_t result = RADAR_OK + 1; result <= RADAR_BAD_PAYLOAD; result++) {
+        out.printf(" %lu %s%s", (unsigned long)_rejected[result], radarResultName((RadarResult)result),
+            result < RADAR_BAD_PAYLOAD ? "," : "\n");
+    }
+#ifdef WEBSOCKETS_TX_QUEUE_SIZE
+    out.printf("Link: %u bytes queued, congested %lu times, %lu messages dropped, %lu lines skipped\n",
+        (unsigned)_socket.txQueued(), (unsigned long)_congestions, (unsigned long)_socket.txDropped(),
+        (unsigned long)_linesSkipped);
+#endif
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <WebSocketsClient.h>
+
+#include "change_filter.h"
+#include "latency_trace.h"
+#include "sample_batcher.h"
+#include "sample_log.h"
+#include "spsc_queue.h"
+#include "telemetry.h"
+#include "uart_framer.h"
+
+// Binary records (see telemetry.h) are the default; set to 0 to send the
+// JSON form instead, e.g. when pointing the board at a plain text consumer.
+#ifndef TELEMETRY_BINARY
+#define TELEMETRY_BINARY 1
+#endif
+
+// Set to 1 to report stage timestamps of sampled seqs to the server (see
+// LATENCY_TRACE_EVERY in latency_trace.h) and answer its clock probes. Off
+// by default: every traced packet costs an extra uplink frame.
+#ifndef LATENCY_TRACE
+#define LATENCY_TRACE 0
+#endif
+
+// A decoded sample on its way to the network side
+struct QueuedSample {
+    PresenceSample sample;
+    uint32_t frameUs;
+    uint32_t queuedUs;
+};
+
+// Text lines from the sensor, copied out of the framer
+struct SensorLine {
+    uint8_t length;
+    char text[UART_FRAMER_MAX_FRAME + 1];
+};
+
+// Sensor-to-server data path, independent of how it is scheduled.
+//
+// pollSensor() drains the UART, decodes radar frames and queues samples;
+// pollNetwork() logs them, sends them (batched, paced after an outage) and
+// handles acks. The two sides share nothing but lock-free SPSC queues, so
+// they can run on different cores: the board calls them from two pinned
+// FreeRTOS tasks, the native bench from two threads.
+//
+// With the socket's send queue enabled (WEBSOCKETS_TX_QUEUE_SIZE) the
+// network side does not wait on a slow link either: past the queue's high
+// watermark samples stay in the log until it drained below the low one.
+class Pipeline {
+  public:
+    typedef void (*Notify)(void* ctx);
+    // Hooks for the native bench; unset on the board.
+    typedef void (*SampleHook)(const PresenceSample& sample, void* ctx);
+    typedef void (*PacketHook)(const uint8_t* data, size_t length, void* ctx);
+
+    Pipeline(WebSocketsClient& socket, const char* sensorId);
+
+    // `notify` is called from the sensor side whenever something was queued.
+    // Returns false if the offline log is RAM only.
+    bool begin(Notify notify = nullptr, void* ctx = nullptr);
+    void setHooks(SampleHook sample, PacketHook packet, void* ctx);
+
+    // Sensor side. Never blocks.
+    void pollSensor(Stream& uart);
+
+    // Network side, after webSocket.loop().
+    void pollNetwork();
+    // Pass every WebSocket event through here; returns true if it was
+    // consumed (server acks, heartbeats and send queue watermarks).
+    bool handleEvent(WStype_t type, const uint8_t* payload, size_t length);
+
+    void printStats(Print& out) const;
+
+    const UartFramer& framer() const { return _framer; }
+    const ChangeFilter& changeFilter() const { return _changes; }
+    const SampleBatcher& batcher() const { return _batcher; }
+    const SampleLog& log() const { return _log; }
+    // First seq issued since begin()
+    uint32_t firstSeq() const { return _firstSeq; }
+    uint32_t sampleDrops() const { return _samples.drops(); }
+    uint32_t lineDrops() const { return _lines.drops(); }
+    // Between the socket's high and low send queue watermarks; samples are
+    // held in the log meanwhile.
+    bool congested() const { return _congested; }
+    uint32_t congestions() const { return _congestions; }
+
+  private:
+    static void onSensorLine(const uint8_t* line, size_t length, void* ctx);
+    static void onSensorFrame(const uint8_t* frame, size_t length, void* ctx);
+    static bool sendTelemetry(const uint8_t* data, size_t length, void* ctx);
+
+    void sendSensorLine(const SensorLine& line);
+    void sendSample(const PresenceSample& sample, bool replay, uint32_t prevSeq);
+    void sendFromLog();
+    bool handleServerAck(const char* text);
+    bool handleHeartbeat(const char* text, uint32_t rxUs);
+    void sendTrace(const uint8_t* packet, size_t length, uint32_t sentUs);
+    void reserveSeqs(uint32_t seq);
+    void sendHello();
+
+    WebSocketsClient& _socket;
+    const char* _sensorId;
+
+    Notify _notify = nullptr;
+    void* _notifyCtx = nullptr;
+    SampleHook _sampleHook = nullptr;
+    PacketHook _packetHook = nullptr;
+    void* _hookCtx = nullptr;
+
+    // Sensor side
+    UartFramer _framer;
+    ChangeFilter _changes;
+    uint32_t _seq = 0;
+    uint32_t _rejected[RADAR_BAD_PAYLOAD + 1] = {};    // frames, per RadarResult
+
+    SpscQueue<QueuedSample, 32> _samples;
+    SpscQueue<SensorLine, 4> _lines;
+
+    // Network side
+    SampleBatcher _batcher;
+    SampleLog _log;
+    LatencyTrace _trace;
+    Preferences _prefs;
+    uint32_t _firstSeq = 1;
+    uint32_t _prevFirstSeq = 0;    // of the boot before, 0 if unknown
+    uint32_t _seqReserved = 0;    // in NVS: no seq below it is issued after a reset
+    char _jsonBuffer[256];    // only used while offline, for the serial echo
+    uint32_t _lastAckAt = 0;
+    uint32_t _lastRefill = 0;
+    uint32_t _credit = 0;
+    bool _congested = false;
+    uint32_t _congestions = 0;
+    uint32_t _linesSkipped = 0;
+};
@@ -0,0 +1,174 @@
+#include "radar_protocol.h"
+
+#include <string.h>
+
+static uint16_t readU16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+// LD2450 encodes signed values as sign-magnitude with bit 15 set for positive
+static int16_t readSignMagnitude(const uint8_t* p) {
+    uint16_t raw = readU16(p);
+    if (raw & 0x8000) {
+        return (int16_t)(raw & 0x7FFF);
+    }
+    return (int16_t)-(int16_t)raw;
+}
+
+static uint16_t isqrt32(uint32_t v) {
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint16_t)root;
+}
+
+// 3 x 8 byte target slots: x, y, speed, gate resolution; all-zero = empty slot
+static bool decodeLd2450(const uint8_t* payload, size_t length, TargetFrame& out) {
+    (void)length;
+    out.model = RADAR_MODEL_LD2450;
+    out.targetCount = 0;
+    for (uint8_t i = 0; i < 3; i++) {
+        const uint8_t* slot = payload + i * 8;
+        bool empty = true;
+        for (uint8_t b = 0; b < 8; b++) {
+            if (slot[b]) {
+                empty = false;
+                break;
+            }
+        }
+        if (empty) {
+            continue;
+        }
+        RadarTarget& t = out.targets[out.targetCount++];
+        t.x = readSignMagnitude(slot);
+        t.y = readSignMagnitude(slot + 2);
+        t.speed = readSignMagnitude(slot + 4);
+        t.distance = isqrt32((uint32_t)((int32_t)t.x * t.x) + (uint32_t)((int32_t)t.y * t.y));
+    }
+    return true;
+}
+
+// type, 0xAA, state, moving cm(2), energy, static cm(2), energy, detect cm(2), ..., 0x55, 0x00
+static bool decodeLd2410(const uint8_t* payload, size_t length, TargetFrame& out) {
+    (void)length;
+    if (payload[0] != 0x01 && payload[0] != 0x02) {
+        return false;
+    }
+    out.model = RADAR_MODEL_LD2410;
+    out.targetCount = 0;
+
+    uint8_t state = payload[2];
+    if (state == 0 || state > 3) {
+        return state == 0;
+    }
+
+    RadarTarget& t = out.targets[out.targetCount++];
+    uint16_t cm = (state & 0x01) ? readU16(payload + 3) : readU16(payload + 6);
+    if (cm == 0) {
+        cm = readU16(payload + 9);
+    }
+    t.x = 0;
+    t.y = (int16_t)(cm * 10);
+    t.speed = 0;
+    t.distance = (uint16_t)(cm * 10);
+    return true;
+}
+
+const RadarFrameSpec RADAR_FRAME_SPECS[] = {
+    // model               hdr  header                    tail tail                      len  min max  checks
+    { RADAR_MODEL_LD2450, 4, { 0xAA, 0xFF, 0x03, 0x00 }, 2, { 0x55, 0xCC, 0x00, 0x00 }, 0, 24, 24, 0, { { 0, 0 }, { 0, 0 } }, decodeLd2450 },
+    { RADAR_MODEL_LD2410, 4, { 0xF4, 0xF3, 0xF2, 0xF1 }, 4, { 0xF8, 0xF7, 0xF6, 0xF5 }, 2, 13, 35, 2, { { 1, 0xAA }, { -2, 0x55 } }, decodeLd2410 },
+};
+
+const size_t RADAR_FRAME_SPEC_COUNT = sizeof(RADAR_FRAME_SPECS) / sizeof(RADAR_FRAME_SPECS[0]);
+
+static int payloadLength(const RadarFrameSpec& spec, const uint8_t* data) {
+    if (spec.lengthFieldSize == 0) {
+        return spec.minPayload;
+    }
+    return readU16(data + spec.headerLength);
+}
+
+int radarFrameSize(const uint8_t* data, size_t avail) {
+    bool prefix = false;
+    for (size_t i = 0; i < RADAR_FRAME_SPEC_COUNT; i++) {
+        const RadarFrameSpec& spec = RADAR_FRAME_SPECS[i];
+        size_t n = avail < spec.headerLength ? avail : spec.headerLength;
+        if (memcmp(data, spec.header, n) != 0) {
+            continue;
+        }
+        size_t need = spec.headerLength + spec.lengthFieldSize;
+        if (avail < need) {
+            prefix = true;
+            continue;
+        }
+        int payload = payloadLength(spec, data);
+        if (payload < spec.minPayload || payload > spec.maxPayload) {
+            continue;
+        }
+        return (int)(need + payload + spec.tailLength);
+    }
+    return prefix ? -1 : 0;
+}
+
+RadarResult radarDecodeFrame(const uint8_t* frame, size_t length, TargetFrame& out) {
+    memset(&out, 0, sizeof(out));
+
+    for (size_t i = 0; i < RADAR_FRAME_SPEC_COUNT; i++) {
+        const RadarFrameSpec& spec = RADAR_FRAME_SPECS[i];
+        size_t offset = spec.headerLength + spec.lengthFieldSize;
+        if (length < offset || memcmp(frame, spec.header, spec.headerLength) != 0) {
+            continue;
+        }
+
+        int payload = payloadLength(spec, frame);
+        if (payload < spec.minPayload || payload > spec.maxPayload || length != offset + payload + spec.tailLength) {
+            return RADAR_BAD_LENGTH;
+        }
+        if (memcmp(frame + offset + payload, spec.tail, spec.tailLength) != 0) {
+            return RADAR_BAD_TAIL;
+        }
+
+        const uint8_t* data = frame + offset;
+        for (uint8_t c = 0; c < spec.checkCount; c++) {
+            int pos = spec.checks[c].offset >= 0 ? spec.checks[c].offset : payload + spec.checks[c].offset;
+            if (data[pos] != spec.checks[c].value) {
+                return RADAR_BAD_PAYLOAD;
+            }
+        }
+
+        if (!spec.decode(data, (size_t)payload, out)) {
+            memset(&out, 0, sizeof(out));
+            return RADAR_BAD_PAYLOAD;
+        }
+        return RADAR_OK;
+    }
+    return RADAR_BAD_HEADER;
+}
+
+const char* radarResultName(RadarResult result) {
+    switch (result) {
+        case RADAR_OK:
+            return "ok";
+        case RADAR_BAD_HEADER:
+            return "bad header";
+        case RADAR_BAD_LENGTH:
+            return "bad length";
+        case RADAR_BAD_TAIL:
+            return "bad tail";
+        case RADAR_BAD_PAYLOAD:
+            return "bad payload";
+    }
+    return "unknown";
+}
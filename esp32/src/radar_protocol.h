@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decoder for the binary report frames of the HLK mmWave radars
+// (header | [length] | payload | tail). Plain C++ with no Arduino
+// dependencies so it can be built and fed recorded captures on the host.
+
+#define RADAR_MAX_TARGETS 3
+
+enum RadarModel : uint8_t {
+    RADAR_MODEL_NONE = 0,
+    RADAR_MODEL_LD2450 = 1,    // multi-target tracking, x/y/speed per target
+    RADAR_MODEL_LD2410 = 2,    // single-zone presence, distance only
+};
+
+enum RadarResult : uint8_t {
+    RADAR_OK = 0,
+    RADAR_BAD_HEADER,
+    RADAR_BAD_LENGTH,
+    RADAR_BAD_TAIL,
+    RADAR_BAD_PAYLOAD,
+};
+
+// One tracked target, in the sensor's own units.
+struct __attribute__((packed)) RadarTarget {
+    int16_t x;            // mm, lateral offset (0 if the model has no angle)
+    int16_t y;            // mm, forward distance
+    int16_t speed;        // cm/s, negative = approaching
+    uint16_t distance;    // mm, straight-line range
+};
+
+// Decoded report; only the first `targetCount` entries of `targets` are set.
+struct __attribute__((packed)) TargetFrame {
+    uint8_t model;          // RadarModel
+    uint8_t targetCount;
+    RadarTarget targets[RADAR_MAX_TARGETS];
+};
+
+// Fixed byte that must appear in a valid payload. Negative offsets count
+// back from the end of the payload.
+struct RadarByteCheck {
+    int8_t offset;
+    uint8_t value;
+};
+
+// One row of the protocol table. Everything that decides whether a frame
+// is valid lives here; the per-model decode function only unpacks fields.
+struct RadarFrameSpec {
+    RadarModel model;
+    uint8_t headerLength;
+    uint8_t header[4];
+    uint8_t tailLength;
+    uint8_t tail[4];
+    uint8_t lengthFieldSize;    // 0 = fixed payload, 2 = little-endian u16 after the header
+    uint16_t minPayload;
+    uint16_t maxPayload;
+    uint8_t checkCount;
+    RadarByteCheck checks[2];
+    bool (*decode)(const uint8_t* payload, size_t length, TargetFrame& out);
+};
+
+extern const RadarFrameSpec RADAR_FRAME_SPECS[];
+extern const size_t RADAR_FRAME_SPEC_COUNT;
+
+// UartFramer::FrameSizer for radar frames: >0 total frame length,
+// -1 valid prefix but more bytes needed, 0 not a radar frame.
+int radarFrameSize(const uint8_t* data, size_t avail);
+
+// Validate a complete frame against the table and decode it into `out`.
+RadarResult radarDecodeFrame(const uint8_t* frame, size_t length, TargetFrame& out);
+
+const char* radarResultName(RadarResult result);
@@ -0,0 +1,78 @@
+#include "sample_batcher.h"
+
+SampleBatcher::SampleBatcher(const char* sensorId, FlushHandler handler, void* ctx)
+    : _sensorId(sensorId), _handler(handler), _ctx(ctx), _writer(_buffer, sizeof(_buffer)) {
+}
+
+void SampleBatcher::configure(uint8_t maxSamples, uint32_t maxAgeMs) {
+    if (maxSamples < 1) {
+        maxSamples = 1;
+    }
+    if (maxSamples > BATCH_MAX_SAMPLES) {
+        maxSamples = BATCH_MAX_SAMPLES;
+    }
+    _maxSamples = maxSamples;
+    _maxAgeMs = maxAgeMs;
+}
+
+void SampleBatcher::add(const PresenceSample& sample, uint32_t now, bool replay, uint32_t prevSeq) {
+    if (pending() > 0 && (replay != _replay || prevSeq != _lastSeq)) {
+        flush();
+    }
+    if (pending() == 0) {
+        _replay = replay;
+        _writer.begin(_sensorId, replay ? TELEMETRY_FLAG_REPLAY : 0, prevSeq);
+        _openedAt = now;
+    }
+
+    if (!_writer.add(sample)) {
+        // cannot happen with BATCH_BUFFER_SIZE, but never lose the sample
+        flush();
+        _writer.begin(_sensorId, replay ? TELEMETRY_FLAG_REPLAY : 0, prevSeq);
+        _openedAt = now;
+        _writer.add(sample);
+    }
+    _lastSeq = sample.seq;
+
+    if (replay) {
+        if (pending() >= _maxSamples) {
+            flush();
+        }
+        return;
+    }
+
+    bool presence = sample.frame.targetCount > 0;
+    bool transition = presence != _lastPresence;
+    _lastPresence = presence;
+
+    if (transition) {
+        _transitionFlushes++;
+        flush();
+    } else if (pending() >= _maxSamples) {
+        flush();
+    }
+}
+
+void SampleBatcher::poll(uint32_t now) {
+    if (pending() > 0 && (now - _openedAt) >= _maxAgeMs) {
+        flush();
+    }
+}
+
+bool SampleBatcher::flush() {
+    uint8_t count = pending();
+    if (count == 0) {
+        return true;
+    }
+
+    bool ok = _handler && _handler(_writer.data(), _writer.length(), _ctx);
+    if (ok) {
+        _packetsSent++;
+        _samplesSent += count;
+    } else {
+        _packetsDropped++;
+    }
+
+    _writer.begin(_sensorId);
+    return ok;
+}
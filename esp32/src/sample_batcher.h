@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "telemetry.h"
+
+// Upper bound for the samples packed into one telemetry packet.
+#ifndef BATCH_MAX_SAMPLES
+#define BATCH_MAX_SAMPLES 16
+#endif
+
+#define BATCH_BUFFER_SIZE (9 + TELEMETRY_MAX_SENSOR_ID + BATCH_MAX_SAMPLES * TELEMETRY_MAX_SAMPLE_SIZE)
+
+// Coalesces presence samples into multi-sample telemetry packets.
+//
+// A packet is flushed when it holds `maxSamples`, when its oldest sample is
+// `maxAgeMs` old (checked from poll()), or immediately when a sample flips
+// presence, so occupancy transitions are never held back by the window.
+// Replayed backlog goes into its own packets (TELEMETRY_FLAG_REPLAY) and
+// does not count as a transition. A packet only holds samples that follow
+// each other in the log: one whose prevSeq is not the last sample added
+// starts a new packet.
+class SampleBatcher {
+  public:
+    // Return false if the packet could not be sent; it is dropped either way,
+    // so the owner has to hand its samples out again.
+    typedef bool (*FlushHandler)(const uint8_t* data, size_t length, void* ctx);
+
+    SampleBatcher(const char* sensorId, FlushHandler handler, void* ctx = nullptr);
+
+    // maxSamples is clamped to 1..BATCH_MAX_SAMPLES; 1 disables batching.
+    void configure(uint8_t maxSamples, uint32_t maxAgeMs);
+
+    // `prevSeq` as handed out by SampleLog::next()
+    void add(const PresenceSample& sample, uint32_t now, bool replay = false, uint32_t prevSeq = 0);
+    void poll(uint32_t now);
+    bool flush();
+
+    uint8_t pending() const { return _writer.sampleCount(); }
+
+    uint32_t packetsSent() const { return _packetsSent; }
+    uint32_t samplesSent() const { return _samplesSent; }
+    uint32_t packetsDropped() const { return _packetsDropped; }
+    uint32_t transitionFlushes() const { return _transitionFlushes; }
+
+  private:
+    const char* _sensorId;
+    FlushHandler _handler;
+    void* _ctx;
+
+    uint8_t _maxSamples = 8;
+    uint32_t _maxAgeMs = 250;
+
+    uint8_t _buffer[BATCH_BUFFER_SIZE];
+    TelemetryWriter _writer;
+    uint32_t _openedAt = 0;
+    bool _replay = false;
+    uint32_t _lastSeq = 0;    // of the last sample in the packet
+    bool _lastPresence = false;
+
+    uint32_t _packetsSent = 0;
+    uint32_t _samplesSent = 0;
+    uint32_t _packetsDropped = 0;
+    uint32_t _transitionFlushes = 0;
+};
@@ -0,0 +1,238 @@
+#include "sample_log.h"
+
+#if SAMPLE_LOG_SPILL
+#include <LittleFS.h>
+#endif
+
+static_assert(SAMPLE_LOG_SPILL_BLOCK <= SAMPLE_LOG_RAM_CAPACITY, "spill block larger than the RAM ring");
+static_assert(SAMPLE_LOG_SPILL_BLOCK <= SAMPLE_LOG_SPILL_CAPACITY, "spill block larger than the flash ring");
+
+#if SAMPLE_LOG_SPILL
+// File layout: header, then SAMPLE_LOG_SPILL_CAPACITY fixed-size slots.
+// The header is rewritten after every block, so after a crash it can only
+// be behind: some acknowledged samples get sent again, none are lost.
+static const uint32_t SPILL_MAGIC = 0x474F4C53;    // "SLOG"
+
+struct SpillHeader {
+    uint32_t magic;
+    uint32_t recordSize;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t count;
+};
+
+static File spillFile;
+#endif
+
+bool SampleLog::begin() {
+    _spillReady = spillOpen();
+    if (_spillCount > 0) {
+        PresenceSample newest;
+        if (spillRead((_spillHead + _spillCount - 1) % SAMPLE_LOG_SPILL_CAPACITY, newest)) {
+            _lastSeq = newest.seq;
+        }
+    }
+    return _spillReady;
+}
+
+void SampleLog::append(const PresenceSample& sample) {
+    if (_ramCount == SAMPLE_LOG_RAM_CAPACITY && _spillReady) {
+        spill(SAMPLE_LOG_SPILL_BLOCK);
+    }
+    if (_ramCount == SAMPLE_LOG_RAM_CAPACITY) {
+        // RAM only (or the flash gave up): the oldest sample goes
+        dropOldest();
+        _lost++;
+    }
+
+    _ram[(_ramHead + _ramCount) % SAMPLE_LOG_RAM_CAPACITY] = sample;
+    _ramCount++;
+    _lastSeq = sample.seq;
+}
+
+bool SampleLog::next(PresenceSample& sample, uint32_t& prevSeq) {
+    if (_sent >= size() || !readAt(_sent, sample)) {
+        return false;
+    }
+    prevSeq = _sent > 0 ? _sentSeq : 0;
+    _sentSeq = sample.seq;
+    _sent++;
+    return true;
+}
+
+bool SampleLog::ack(uint32_t seq) {
+    bool trimmed = false;
+    PresenceSample oldest;
+    while (size() > 0 && readAt(0, oldest) && oldest.seq <= seq) {
+        dropOldest();
+        trimmed = true;
+    }
+    return trimmed;
+}
+
+// Offset 0 is the oldest sample; the flash part always precedes RAM.
+bool SampleLog::readAt(uint32_t offset, PresenceSample& sample) {
+    if (offset >= _spillCount) {
+        offset -= _spillCount;
+        if (offset >= _ramCount) {
+            return false;
+        }
+        sample = _ram[(_ramHead + offset) % SAMPLE_LOG_RAM_CAPACITY];
+        return true;
+    }
+
+    if (spillRead((_spillHead + offset) % SAMPLE_LOG_SPILL_CAPACITY, sample)) {
+        return true;
+    }
+
+    // Unreadable flash: give up on it rather than stall the log
+    _lost += _spillCount;
+    _sent = _sent > _spillCount ? _sent - _spillCount : 0;
+    _spillCount = 0;
+    _spillReady = false;
+    return false;
+}
+
+void SampleLog::dropOldest() {
+    if (_spillCount > 0) {
+        _spillHead = (_spillHead + 1) % SAMPLE_LOG_SPILL_CAPACITY;
+        _spillCount--;
+        if (_spillCount == 0) {
+            spillReset();
+        }
+    } else if (_ramCount > 0) {
+        _ramHead = (_ramHead + 1) % SAMPLE_LOG_RAM_CAPACITY;
+        _ramCount--;
+    } else {
+        return;
+    }
+
+    if (_sent > 0) {
+        _sent--;
+    }
+}
+
+void SampleLog::flush() {
+    if (_spillReady && _ramCount > 0) {
+        spill(_ramCount);
+    }
+}
+
+void SampleLog::poll(uint32_t now) {
+#if SAMPLE_LOG_FLUSH_MS
+    if (_spillReady && _ramCount > 0 && now - _ram[_ramHead].timestamp >= SAMPLE_LOG_FLUSH_MS) {
+        flush();
+    }
+#endif
+}
+
+// Move the `count` oldest RAM samples to the end of the flash ring.
+void SampleLog::spill(uint32_t count) {
+    // Flash ring full: its oldest samples make room
+    while (_spillCount + count > SAMPLE_LOG_SPILL_CAPACITY) {
+        dropOldest();
+        _lost++;
+    }
+
+    if (!spillWrite(count)) {
+        _lost += _spillCount;
+        _sent = _sent > _spillCount ? _sent - _spillCount : 0;
+        _spillCount = 0;
+        _spillReady = false;
+        return;
+    }
+
+    _ramHead = (_ramHead + count) % SAMPLE_LOG_RAM_CAPACITY;
+    _ramCount -= count;
+    _spillCount += count;
+    spillSaveHeader();
+}
+
+bool SampleLog::spillOpen() {
+#if SAMPLE_LOG_SPILL
+    if (!LittleFS.begin(true)) {
+        return false;
+    }
+
+    if (LittleFS.exists(SAMPLE_LOG_SPILL_PATH)) {
+        spillFile = LittleFS.open(SAMPLE_LOG_SPILL_PATH, "r+");
+        SpillHeader header;
+        if (spillFile && spillFile.read((uint8_t*)&header, sizeof(header)) == sizeof(header)
+            && header.magic == SPILL_MAGIC && header.recordSize == sizeof(PresenceSample)
+            && header.capacity == SAMPLE_LOG_SPILL_CAPACITY && header.head < SAMPLE_LOG_SPILL_CAPACITY
+            && header.count <= SAMPLE_LOG_SPILL_CAPACITY) {
+            _spillHead = header.head;
+            _spillCount = header.count;
+            return true;
+        }
+        spillFile.close();
+    }
+
+    spillFile = LittleFS.open(SAMPLE_LOG_SPILL_PATH, "w+");
+    if (!spillFile) {
+        return false;
+    }
+    _spillHead = 0;
+    _spillCount = 0;
+    spillSaveHeader();
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Writes the `count` oldest RAM samples behind the newest flash slot.
+bool SampleLog::spillWrite(uint32_t count) {
+#if SAMPLE_LOG_SPILL
+    uint32_t slot = (_spillHead + _spillCount) % SAMPLE_LOG_SPILL_CAPACITY;
+    for (uint32_t i = 0; i < count; i++) {
+        if ((i == 0 || slot == 0)
+            && !spillFile.seek(sizeof(SpillHeader) + slot * sizeof(PresenceSample))) {
+            return false;
+        }
+        const PresenceSample& sample = _ram[(_ramHead + i) % SAMPLE_LOG_RAM_CAPACITY];
+        if (spillFile.write((const uint8_t*)&sample, sizeof(sample)) != sizeof(sample)) {
+            return false;
+        }
+        slot = (slot + 1) % SAMPLE_LOG_SPILL_CAPACITY;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool SampleLog::spillRead(uint32_t slot, PresenceSample& sample) {
+#if SAMPLE_LOG_SPILL
+    return spillFile
+        && spillFile.seek(sizeof(SpillHeader) + slot * sizeof(PresenceSample))
+        && spillFile.read((uint8_t*)&sample, sizeof(sample)) == sizeof(sample);
+#else
+    return false;
+#endif
+}
+
+void SampleLog::spillSaveHeader() {
+#if SAMPLE_LOG_SPILL
+    SpillHeader header = { SPILL_MAGIC, sizeof(PresenceSample), SAMPLE_LOG_SPILL_CAPACITY, _spillHead, _spillCount };
+    if (spillFile.seek(0)) {
+        spillFile.write((const uint8_t*)&header, sizeof(header));
+    }
+    spillFile.flush();
+#endif
+}
+
+// Flash part drained: truncate so the file does not keep its high-water size.
+void SampleLog::spillReset() {
+#if SAMPLE_LOG_SPILL
+    _spillHead = 0;
+    _spillCount = 0;
+    spillFile.close();
+    spillFile = LittleFS.open(SAMPLE_LOG_SPILL_PATH, "w+");
+    if (!spillFile) {
+        _spillReady = false;
+        return;
+    }
+    spillSaveHeader();
+#endif
+}
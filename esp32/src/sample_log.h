@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "telemetry.h"
+
+// Unacknowledged samples kept in RAM.
+#ifndef SAMPLE_LOG_RAM_CAPACITY
+#define SAMPLE_LOG_RAM_CAPACITY 256
+#endif
+
+// Set to 0 to keep the log in RAM only (oldest samples are dropped when full).
+#ifndef SAMPLE_LOG_SPILL
+#define SAMPLE_LOG_SPILL 1
+#endif
+
+// Flash ring on LittleFS: capacity in samples, and how many of the oldest
+// RAM samples move there in one write once RAM is full (fewer, larger
+// writes are kinder to the flash).
+#ifndef SAMPLE_LOG_SPILL_CAPACITY
+#define SAMPLE_LOG_SPILL_CAPACITY 16384
+#endif
+#ifndef SAMPLE_LOG_SPILL_BLOCK
+#define SAMPLE_LOG_SPILL_BLOCK 64
+#endif
+
+// RAM samples that have waited this long (ms) for an ack all move to flash,
+// so a reset during an outage loses at most the last SAMPLE_LOG_FLUSH_MS of
+// samples. 0 spills only when RAM is full.
+#ifndef SAMPLE_LOG_FLUSH_MS
+#define SAMPLE_LOG_FLUSH_MS 5000
+#endif
+
+#define SAMPLE_LOG_SPILL_PATH "/samples.log"
+
+// Store-and-forward log of presence samples, oldest first.
+//
+// Every sample is appended; the sender walks the log with next() and the
+// server's cumulative ack(seq) trims it. Anything sent but not acknowledged
+// is sent again after rewind() (reconnect, ack timeout, a failed send), so
+// an outage costs latency, not history. next() also gives the seq of the
+// sample before, 0 for the oldest one, which the server uses to ack only
+// what it has without a gap: a packet lost on the way holds the ack back
+// until it is sent again. With the spill enabled, what is in flash survives a
+// reboot: everything but the samples of the last SAMPLE_LOG_FLUSH_MS, or
+// of the time since flush() if that is shorter. After a reboot lastSeq() is
+// the newest sample restored; the Pipeline keeps seqs from being issued
+// twice (see seqReserveBlock). Only the oldest samples are ever dropped on
+// purpose, and they are counted in lost().
+//
+// Not thread-safe: owned by the network task.
+class SampleLog {
+  public:
+    // Mount and restore the flash part; false means RAM only.
+    bool begin();
+
+    void append(const PresenceSample& sample);
+
+    // Next sample not yet handed out since the last rewind(), and the seq of
+    // the one before it in the log (0 if it is the oldest).
+    bool next(PresenceSample& sample, uint32_t& prevSeq);
+    // Everything up to and including `seq` has been received. Returns true
+    // if that trimmed anything.
+    bool ack(uint32_t seq);
+    // Hand out everything unacknowledged again.
+    void rewind() { _sent = 0; }
+
+    // Move every RAM sample to flash, e.g. when the link goes down.
+    void flush();
+    // Flushes once the oldest RAM sample is SAMPLE_LOG_FLUSH_MS old
+    // (`now` in millis(), the clock of PresenceSample::timestamp).
+    void poll(uint32_t now);
+
+    uint32_t size() const { return _spillCount + _ramCount; }
+    uint32_t unsent() const { return size() - _sent; }
+    uint32_t inFlight() const { return _sent; }
+    uint32_t spilled() const { return _spillCount; }
+    uint32_t lastSeq() const { return _lastSeq; }
+    uint32_t lost() const { return _lost; }
+
+  private:
+    bool readAt(uint32_t offset, PresenceSample& sample);
+    void dropOldest();
+    void spill(uint32_t count);
+
+    bool spillOpen();
+    bool spillWrite(uint32_t count);
+    bool spillRead(uint32_t slot, PresenceSample& sample);
+    void spillSaveHeader();
+    void spillReset();
+
+    PresenceSample _ram[SAMPLE_LOG_RAM_CAPACITY];
+    uint32_t _ramHead = 0;
+    uint32_t _ramCount = 0;
+
+    bool _spillReady = false;
+    uint32_t _spillHead = 0;
+    uint32_t _spillCount = 0;
+
+    uint32_t _sent = 0;    // samples from the oldest one that were handed out
+    uint32_t _sentSeq = 0;    // the last of them
+    uint32_t _lastSeq = 0;
+    uint32_t _lost = 0;
+};
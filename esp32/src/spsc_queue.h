@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// Lock-free single-producer / single-consumer ring of fixed-size records.
+//
+// Exactly one task may push() and exactly one other task may pop(); neither
+// side ever blocks, takes a lock or allocates, so the producer keeps its
+// timing no matter what the consumer is stuck on. A full queue drops the
+// new record and counts it. Depth must be a power of two.
+template <typename T, size_t Depth>
+class SpscQueue {
+    static_assert(Depth > 0 && (Depth & (Depth - 1)) == 0, "SpscQueue depth must be a power of two");
+
+  public:
+    // Producer side. Returns false (and counts a drop) when the queue is full.
+    bool push(const T& item) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        if (head - tail >= Depth) {
+            _drops.store(_drops.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        _items[head & (Depth - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+
+        uint32_t used = head + 1 - tail;
+        if (used > _highWater.load(std::memory_order_relaxed)) {
+            _highWater.store(used, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Consumer side. Returns false when the queue is empty.
+    bool pop(T& item) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        uint32_t head = _head.load(std::memory_order_acquire);
+        if (head == tail) {
+            return false;
+        }
+
+        item = _items[tail & (Depth - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Safe to call from either side; a snapshot only.
+    size_t depth() const {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+    static constexpr size_t capacity() { return Depth; }
+
+    uint32_t drops() const { return _drops.load(std::memory_order_relaxed); }
+    uint32_t highWater() const { return _highWater.load(std::memory_order_relaxed); }
+
+  private:
+    T _items[Depth];
+    std::atomic<uint32_t> _head{0};
+    std::atomic<uint32_t> _tail{0};
+
+    // Written by the producer only.
+    std::atomic<uint32_t> _drops{0};
+    std::atomic<uint32_t> _highWater{0};
+};
@@ -0,0 +1,158 @@
+#include "telemetry.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static uint8_t* putU16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t* putU32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)((v >> 8) & 0xFF);
+    p[2] = (uint8_t)((v >> 16) & 0xFF);
+    p[3] = (uint8_t)(v >> 24);
+    return p + 4;
+}
+
+TelemetryWriter::TelemetryWriter(uint8_t* buffer, size_t capacity)
+    : _buffer(buffer), _capacity(capacity) {
+}
+
+bool TelemetryWriter::begin(const char* sensorId, uint8_t flags, uint32_t prevSeq) {
+    size_t idLen = strlen(sensorId);
+    if (idLen > TELEMETRY_MAX_SENSOR_ID) {
+        idLen = TELEMETRY_MAX_SENSOR_ID;
+    }
+
+    _length = 0;
+    _sampleCount = 0;
+    if (_capacity < 9 + idLen) {
+        return false;
+    }
+
+    uint8_t* p = _buffer;
+    *p++ = TELEMETRY_MAGIC;
+    *p++ = TELEMETRY_VERSION;
+    *p++ = flags;
+    *p++ = (uint8_t)idLen;
+    memcpy(p, sensorId, idLen);
+    p += idLen;
+    p = putU32(p, prevSeq);
+    _countOffset = (size_t)(p - _buffer);
+    *p++ = 0;
+    _length = (size_t)(p - _buffer);
+    return true;
+}
+
+size_t TelemetryWriter::sampleSize(const PresenceSample& sample) {
+    return TELEMETRY_SAMPLE_HEADER_SIZE + (size_t)sample.frame.targetCount * TELEMETRY_TARGET_SIZE;
+}
+
+bool TelemetryWriter::add(const PresenceSample& sample) {
+    if (_length == 0 || _sampleCount == 0xFF || sampleSize(sample) > remaining()) {
+        return false;
+    }
+
+    uint8_t* p = _buffer + _length;
+    p = putU32(p, sample.seq);
+    p = putU32(p, sample.timestamp);
+    *p++ = sample.frame.targetCount;
+    for (uint8_t i = 0; i < sample.frame.targetCount; i++) {
+        const RadarTarget& t = sample.frame.targets[i];
+        p = putU16(p, (uint16_t)t.x);
+        p = putU16(p, (uint16_t)t.y);
+        p = putU16(p, (uint16_t)t.speed);
+        p = putU16(p, t.distance);
+    }
+
+    _length = (size_t)(p - _buffer);
+    _buffer[_countOffset] = ++_sampleCount;
+    return true;
+}
+
+size_t telemetryPacketSeqs(const uint8_t* packet, size_t length, uint32_t* seqs, size_t max) {
+    if (length < 9 || packet[0] != TELEMETRY_MAGIC) {
+        return 0;
+    }
+    size_t offset = 8 + (size_t)packet[3];
+    if (offset >= length) {
+        return 0;
+    }
+
+    uint8_t sampleCount = packet[offset++];
+    size_t count = 0;
+    for (uint8_t i = 0; i < sampleCount && count < max; i++) {
+        if (offset + TELEMETRY_SAMPLE_HEADER_SIZE > length) {
+            return 0;
+        }
+        const uint8_t* p = packet + offset;
+        seqs[count++] = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+        offset += TELEMETRY_SAMPLE_HEADER_SIZE + (size_t)p[8] * TELEMETRY_TARGET_SIZE;
+    }
+    return count;
+}
+
+size_t telemetryFormatJson(char* out, size_t capacity, const char* sensorId, const PresenceSample& sample,
+                           uint32_t prevSeq) {
+    int n = snprintf(out, capacity, "{\"sensorId\":\"%s\",\"seq\":%lu,\"prev\":%lu,\"ts\":%lu,\"targets\":[",
+        sensorId, (unsigned long)sample.seq, (unsigned long)prevSeq, (unsigned long)sample.timestamp);
+    if (n < 0 || (size_t)n >= capacity) {
+        return 0;
+    }
+    size_t len = (size_t)n;
+
+    for (uint8_t i = 0; i < sample.frame.targetCount; i++) {
+        const RadarTarget& t = sample.frame.targets[i];
+        n = snprintf(out + len, capacity - len, "%s[%d,%d,%d,%u]", i ? "," : "", t.x, t.y, t.speed, t.distance);
+        if (n < 0 || (size_t)n >= capacity - len) {
+            return 0;
+        }
+        len += (size_t)n;
+    }
+
+    if (capacity - len < 3) {
+        return 0;
+    }
+    out[len++] = ']';
+    out[len++] = '}';
+    out[len] = '\0';
+    return len;
+}
+
+size_t telemetryFormatHello(char* out, size_t capacity, const char* sensorId, uint32_t bootSeq,
+                            uint32_t prevBootSeq, uint32_t uptimeMs) {
+    int n = snprintf(out, capacity, "{\"type\":\"hello\",\"sensorId\":\"%s\",\"boot\":%lu,\"prevBoot\":%lu,\"uptime\":%lu}",
+        sensorId, (unsigned long)bootSeq, (unsigned long)prevBootSeq, (unsigned long)uptimeMs);
+    return n < 0 || (size_t)n >= capacity ? 0 : (size_t)n;
+}
+
+size_t telemetryFormatRawLine(char* out, size_t capacity, const char* sensorId, const char* line, size_t length) {
+    int n = snprintf(out, capacity, "{\"sensorId\":\"%s\",\"raw\":\"", sensorId);
+    if (n < 0 || (size_t)n >= capacity) {
+        return 0;
+    }
+    size_t len = (size_t)n;
+
+    for (size_t i = 0; i < length; i++) {
+        char c = line[i];
+        bool escape = (c == '"' || c == '\\');
+        if ((unsigned char)c < ' ') {
+            c = ' ';
+        }
+        if (len + (escape ? 2 : 1) + 3 > capacity) {
+            return 0;
+        }
+        if (escape) {
+            out[len++] = '\\';
+        }
+        out[len++] = c;
+    }
+
+    out[len++] = '"';
+    out[len++] = '}';
+    out[len] = '\0';
+    return len;
+}
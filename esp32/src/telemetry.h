@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "radar_protocol.h"
+
+// Binary presence telemetry sent with sendBIN(). All integers little-endian.
+//
+//   packet:  u8 magic (0xA5) | u8 version | u8 flags | u8 idLen | idLen x char
+//            | u32 prevSeq | u8 sampleCount | sampleCount x sample
+//   sample:  u32 seq | u32 timestamp (ms since boot) | u8 targetCount
+//            | targetCount x { i16 x mm | i16 y mm | i16 speed cm/s | u16 distance mm }
+//
+// prevSeq is the seq of the sample before the first one in the sender's
+// log, 0 if there is none still unacked: the server acks no further than
+// where the chain of packets it has is unbroken (see SampleLog).
+//
+// Decoder: raspberry-pi/server/telemetry.js. Bump TELEMETRY_VERSION on any
+// layout change.
+#define TELEMETRY_MAGIC 0xA5
+#define TELEMETRY_VERSION 2
+#define TELEMETRY_MAX_SENSOR_ID 31
+
+// Packet flags
+#define TELEMETRY_FLAG_REPLAY 0x01    // backlog from the offline log, not live
+
+#define TELEMETRY_SAMPLE_HEADER_SIZE 9
+#define TELEMETRY_TARGET_SIZE 8
+#define TELEMETRY_MAX_SAMPLE_SIZE (TELEMETRY_SAMPLE_HEADER_SIZE + RADAR_MAX_TARGETS * TELEMETRY_TARGET_SIZE)
+
+// One decoded radar report as it travels through the firmware.
+struct PresenceSample {
+    uint32_t seq;
+    uint32_t timestamp;
+    TargetFrame frame;
+};
+
+// Appends samples to a caller-owned buffer; never allocates.
+class TelemetryWriter {
+  public:
+    TelemetryWriter(uint8_t* buffer, size_t capacity);
+
+    // Start a new packet, discarding anything written before.
+    bool begin(const char* sensorId, uint8_t flags = 0, uint32_t prevSeq = 0);
+    // Returns false (and writes nothing) if the sample does not fit.
+    bool add(const PresenceSample& sample);
+
+    const uint8_t* data() const { return _buffer; }
+    size_t length() const { return _length; }
+    uint8_t sampleCount() const { return _sampleCount; }
+    size_t remaining() const { return _capacity - _length; }
+
+    static size_t sampleSize(const PresenceSample& sample);
+
+  private:
+    uint8_t* _buffer;
+    size_t _capacity;
+    size_t _length = 0;
+    size_t _countOffset = 0;
+    uint8_t _sampleCount = 0;
+};
+
+// Reads back the sample seqs of a packet built by TelemetryWriter, up to
+// `max` of them. Returns how many were stored; 0 if the packet is malformed.
+size_t telemetryPacketSeqs(const uint8_t* packet, size_t length, uint32_t* seqs, size_t max);
+
+// JSON fallback for consumers that cannot take binary frames, e.g.
+// {"sensorId":"sensor1","seq":12,"prev":11,"ts":3456,"targets":[[x,y,speed,distance]]}
+// Returns the length written, or 0 if `capacity` is too small.
+size_t telemetryFormatJson(char* out, size_t capacity, const char* sensorId, const PresenceSample& sample,
+                           uint32_t prevSeq);
+
+// {"type":"hello","sensorId":"sensor1","boot":1025,"prevBoot":1,"uptime":5230}, sent
+// on every connection: the first seq of this boot and of the one before, and
+// millis() now, so the server can turn sample timestamps into wall time.
+size_t telemetryFormatHello(char* out, size_t capacity, const char* sensorId, uint32_t bootSeq,
+                            uint32_t prevBootSeq, uint32_t uptimeMs);
+
+// {"sensorId":"sensor1","raw":"<line>"} with the line JSON-escaped, for text sensors.
+size_t telemetryFormatRawLine(char* out, size_t capacity, const char* sensorId, const char* line, size_t length);
@@ -0,0 +1,187 @@
+#include "uart_framer.h"
+
+#include <string.h>
+
+static_assert((UART_FRAMER_RING_SIZE & (UART_FRAMER_RING_SIZE - 1)) == 0, "UART_FRAMER_RING_SIZE must be a power of two");
+static_assert(UART_FRAMER_RING_SIZE > UART_FRAMER_MAX_FRAME + 1, "ring must hold at least one full frame");
+
+UartFramer::UartFramer(FrameHandler handler, void* ctx)
+    : _handler(handler), _ctx(ctx) {
+}
+
+void UartFramer::setBinaryFraming(FrameSizer sizer, FrameHandler handler, void* ctx) {
+    _sizer = sizer;
+    _binaryHandler = handler;
+    _binaryCtx = ctx;
+}
+
+void UartFramer::reset() {
+    _head = 0;
+    _tail = 0;
+    _scan = 0;
+    _discarding = false;
+}
+
+uint16_t UartFramer::contiguousFree() const {
+    uint16_t free = (uint16_t)(RING_MASK - used());
+    uint16_t toEnd = (uint16_t)(UART_FRAMER_RING_SIZE - _head);
+    return free < toEnd ? free : toEnd;
+}
+
+void UartFramer::commit(uint16_t length) {
+    _head = (uint16_t)((_head + length) & RING_MASK);
+}
+
+size_t UartFramer::feed(const uint8_t* data, size_t length) {
+    size_t done = 0;
+    while (done < length) {
+        size_t n = contiguousFree();
+        if (n > length - done) {
+            n = length - done;
+        }
+        memcpy(&_ring[_head], data + done, n);
+        commit((uint16_t)n);
+        extract();
+        done += n;
+    }
+    return done;
+}
+
+#ifdef ARDUINO
+size_t UartFramer::poll(Stream& stream) {
+    size_t total = 0;
+    int avail;
+    while ((avail = stream.available()) > 0) {
+        size_t n = contiguousFree();
+        if (n > (size_t)avail) {
+            n = (size_t)avail;
+        }
+        // at most `available()` bytes are requested, so this returns at once
+        n = stream.readBytes(&_ring[_head], n);
+        if (n == 0) {
+            break;
+        }
+        commit((uint16_t)n);
+        extract();
+        total += n;
+    }
+    return total;
+}
+#endif
+
+void UartFramer::extract() {
+    for (;;) {
+        if (_sizer && !_discarding && _scan == _tail) {
+            int r = extractBinary();
+            if (r > 0) {
+                continue;
+            }
+            if (r < 0) {
+                break;
+            }
+        }
+        if (_scan == _head) {
+            break;
+        }
+        if (_ring[_scan] == '\n') {
+            if (_discarding) {
+                _discarding = false;
+            } else {
+                emitLine(_scan);
+            }
+            _tail = (uint16_t)((_scan + 1) & RING_MASK);
+        }
+        _scan = (uint16_t)((_scan + 1) & RING_MASK);
+    }
+
+    if (_discarding) {
+        // nothing of an over-long line is kept, only its end is awaited
+        _tail = _scan;
+    } else if (used() > UART_FRAMER_MAX_FRAME) {
+        _overflows++;
+        _discarding = true;
+        _tail = _scan;
+    }
+}
+
+// Returns 1 if a frame (or a junk byte) was consumed, 0 if the pending bytes
+// are text, -1 if more bytes are needed before anything can be decided.
+int UartFramer::extractBinary() {
+    uint16_t avail = used();
+    if (avail == 0) {
+        return -1;
+    }
+
+    uint8_t peek[UART_FRAMER_PEEK_SIZE];
+    uint16_t n = avail < UART_FRAMER_PEEK_SIZE ? avail : UART_FRAMER_PEEK_SIZE;
+    copyOut(peek, n);
+
+    int size = _sizer(peek, n);
+    if (size == FRAME_NEED_MORE && n < UART_FRAMER_PEEK_SIZE) {
+        return -1;
+    }
+
+    if (size <= 0 || size > UART_FRAMER_MAX_FRAME) {
+        uint8_t c = peek[0];
+        bool text = (c >= ' ' && c < 0x7F) || c == '\r' || c == '\n' || c == '\t';
+        if (text) {
+            return 0;
+        }
+        // not a frame start and not text: skip one byte to regain sync
+        _resyncs++;
+        _tail = (uint16_t)((_tail + 1) & RING_MASK);
+        _scan = _tail;
+        return 1;
+    }
+
+    if (avail < size) {
+        return -1;
+    }
+
+    copyOut(_frame, (uint16_t)size);
+    _tail = (uint16_t)((_tail + size) & RING_MASK);
+    _scan = _tail;
+    _binaryFramesEmitted++;
+    if (_binaryHandler) {
+        _binaryHandler(_frame, (size_t)size, _binaryCtx);
+    }
+    return 1;
+}
+
+void UartFramer::copyOut(uint8_t* dst, uint16_t length) const {
+    uint16_t first = (uint16_t)(UART_FRAMER_RING_SIZE - _tail);
+    if (first >= length) {
+        memcpy(dst, &_ring[_tail], length);
+    } else {
+        memcpy(dst, &_ring[_tail], first);
+        memcpy(dst + first, &_ring[0], length - first);
+    }
+}
+
+void UartFramer::emitLine(uint16_t end) {
+    uint16_t length = (uint16_t)((end - _tail) & RING_MASK);
+    if (length > UART_FRAMER_MAX_FRAME) {
+        // a long line can arrive complete within a single read
+        _overflows++;
+        return;
+    }
+    copyOut(_frame, length);
+
+    // same trimming the old readStringUntil() + trim() path did
+    uint16_t start = 0;
+    while (start < length && _frame[start] <= ' ') {
+        start++;
+    }
+    while (length > start && _frame[length - 1] <= ' ') {
+        length--;
+    }
+    if (length == start) {
+        return;
+    }
+
+    _frame[length] = '\0';
+    _framesEmitted++;
+    if (_handler) {
+        _handler(_frame + start, length - start, _ctx);
+    }
+}
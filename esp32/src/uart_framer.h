@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+// Raw UART bytes are staged in a fixed ring so a whole burst can be pulled
+// from the driver in one call. Must be a power of two.
+#ifndef UART_FRAMER_RING_SIZE
+#define UART_FRAMER_RING_SIZE 512
+#endif
+
+// Longest frame (line) handed to the callback, excluding the terminator.
+#ifndef UART_FRAMER_MAX_FRAME
+#define UART_FRAMER_MAX_FRAME 255
+#endif
+
+// Bytes of a frame start handed to the binary sizer (header + length field).
+#ifndef UART_FRAMER_PEEK_SIZE
+#define UART_FRAMER_PEEK_SIZE 8
+#endif
+
+// Incremental, allocation-free frame assembler for the mmWave UART.
+//
+// Bytes are pushed in with feed() (or poll() on the board), complete
+// '\n'-terminated lines are trimmed and passed to the handler as a
+// NUL-terminated buffer that is only valid for the duration of the call.
+// Nothing here ever waits for more data: a partial line simply stays in
+// the ring until the rest of it arrives on a later pass.
+//
+// With a binary sizer installed, every frame start is offered to it first
+// so length-prefixed sensor reports can share the stream with text lines.
+class UartFramer {
+  public:
+    typedef void (*FrameHandler)(const uint8_t* frame, size_t length, void* ctx);
+
+    // Inspect the first `avail` bytes of a pending frame. Returns the total
+    // frame length once it is known, FRAME_NEED_MORE while the bytes are a
+    // valid prefix, or FRAME_NOT_BINARY to fall back to line framing.
+    typedef int (*FrameSizer)(const uint8_t* data, size_t avail);
+    static const int FRAME_NOT_BINARY = 0;
+    static const int FRAME_NEED_MORE = -1;
+
+    explicit UartFramer(FrameHandler handler, void* ctx = nullptr);
+
+    void setBinaryFraming(FrameSizer sizer, FrameHandler handler, void* ctx = nullptr);
+
+    // Push raw bytes and emit every frame they complete.
+    // Returns the number of bytes consumed (always `length`).
+    size_t feed(const uint8_t* data, size_t length);
+
+#ifdef ARDUINO
+    // Drain everything the UART driver currently holds. Never blocks.
+    size_t poll(Stream& stream);
+#endif
+
+    void reset();
+
+    uint32_t framesEmitted() const { return _framesEmitted; }
+    uint32_t binaryFramesEmitted() const { return _binaryFramesEmitted; }
+    uint32_t overflows() const { return _overflows; }
+    uint32_t resyncs() const { return _resyncs; }
+
+  private:
+    static const uint16_t RING_MASK = UART_FRAMER_RING_SIZE - 1;
+
+    uint16_t used() const { return (uint16_t)((_head - _tail) & RING_MASK); }
+    uint16_t contiguousFree() const;
+    void commit(uint16_t length);
+    void extract();
+    int extractBinary();
+    void copyOut(uint8_t* dst, uint16_t length) const;
+    void emitLine(uint16_t end);
+
+    FrameHandler _handler;
+    void* _ctx;
+
+    FrameSizer _sizer = nullptr;
+    FrameHandler _binaryHandler = nullptr;
+    void* _binaryCtx = nullptr;
+
+    uint8_t _ring[UART_FRAMER_RING_SIZE];
+    uint16_t _head = 0;    // next write position
+    uint16_t _tail = 0;    // start of the frame being assembled
+    uint16_t _scan = 0;    // first byte not yet checked for a terminator
+    bool _discarding = false;    // dropping an over-long line up to its '\n'
+
+    uint8_t _frame[UART_FRAMER_MAX_FRAME + 1];
+
+    uint32_t _framesEmitted = 0;
+    uint32_t _binaryFramesEmitted = 0;
+    uint32_t _overflows = 0;
+    uint32_t _resyncs = 0;
+};
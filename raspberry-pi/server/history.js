@@ -0,0 +1,281 @@
+// Occupancy history, embedded: no database server, just append-only and
+// fixed-width files under one directory per sensor.
+//
+//   events.bin  every presence change. Chunks of
+//                 0x00 | uvarint t0 (ms) | u8 presence
+//               followed by one varint per further change: the delta-of-delta
+//               of the timestamps, zigzagged and plus one so no change starts
+//               with 0x00. Presence toggles with each change, so it is only
+//               stored at the chunk start (run-length). Each server start
+//               opens a new chunk.
+//   m1.bin      occupied ms per minute,      u16 LE, dense from `epoch`
+//   m15.bin     occupied ms per 15 minutes,  u32 LE
+//   h1.bin      occupied ms per hour,        u32 LE
+//   meta.json   { epoch }: start of bucket 0 of every rollup (hour aligned)
+//
+// The rollups are kept up to date incrementally: when a run of presence
+// ends, and every minute while it lasts, the time it covered is added to
+// the buckets it overlaps. A range query reads one contiguous slice of one
+// rollup file, so even months of hourly data are a few kB off the SD card.
+
+import fs from "fs";
+import path from "path";
+
+const MINUTE = 60 * 1000;
+const HOUR = 60 * MINUTE;
+const CHUNK_START = 0x00;
+
+export const RESOLUTIONS = {
+  "1m": { step: MINUTE, file: "m1.bin", width: 2 },
+  "15m": { step: 15 * MINUTE, file: "m15.bin", width: 4 },
+  "1h": { step: HOUR, file: "h1.bin", width: 4 },
+};
+
+// Most points a series query returns
+export const MAX_POINTS = 2000;
+
+class SensorHistory {
+  constructor(dir) {
+    this.dir = dir;
+    fs.mkdirSync(dir, { recursive: true });
+    const metaPath = path.join(dir, "meta.json");
+    if (fs.existsSync(metaPath)) {
+      this.epoch = JSON.parse(fs.readFileSync(metaPath, "utf8")).epoch;
+    } else {
+      this.epoch = Math.floor(Date.now() / HOUR) * HOUR;
+      fs.writeFileSync(metaPath, JSON.stringify({ epoch: this.epoch }));
+    }
+    this.fds = {};
+    for (const [name, res] of Object.entries(RESOLUTIONS)) {
+      this.fds[name] = fs.openSync(path.join(dir, res.file), fs.existsSync(path.join(dir, res.file)) ? "r+" : "w+");
+    }
+    this.eventsPath = path.join(dir, "events.bin");
+
+    // Current chunk; null until the first change after startup
+    this.prevT = null;
+    this.prevDelta = 0;
+    this.presence = false;
+    this.accountedUntil = 0;    // occupied time before this is in the rollups
+  }
+
+  record(t, presence) {
+    const out = [];
+    if (this.prevT === null || t < this.prevT) {
+      out.push(CHUNK_START);
+      writeUvarint(out, t);
+      out.push(presence ? 1 : 0);
+      this.prevDelta = 0;
+    } else {
+      const delta = t - this.prevT;
+      writeUvarint(out, zigzag(delta - this.prevDelta) + 1);
+      this.prevDelta = delta;
+    }
+    fs.appendFileSync(this.eventsPath, Buffer.from(out));
+
+    if (this.presence) this.account(t);
+    this.prevT = t;
+    this.presence = presence;
+    this.accountedUntil = t;
+  }
+
+  // Moves occupied time up to `t` into the rollups
+  account(t) {
+    const from = Math.max(this.accountedUntil, this.epoch);
+    if (t > from) {
+      for (const name of Object.keys(RESOLUTIONS)) this.addOccupied(name, from, t);
+    }
+    this.accountedUntil = t;
+  }
+
+  addOccupied(name, from, to) {
+    const { step, width } = RESOLUTIONS[name];
+    const first = Math.floor((from - this.epoch) / step);
+    const last = Math.floor((to - 1 - this.epoch) / step);
+    const buf = this.read(name, first, last - first + 1);
+    for (let i = first; i <= last; i++) {
+      const start = this.epoch + i * step;
+      const ms = Math.min(to, start + step) - Math.max(from, start);
+      const off = (i - first) * width;
+      if (width === 2) buf.writeUInt16LE(Math.min(step, buf.readUInt16LE(off) + ms), off);
+      else buf.writeUInt32LE(Math.min(step, buf.readUInt32LE(off) + ms), off);
+    }
+    fs.writeSync(this.fds[name], buf, 0, buf.length, first * width);
+  }
+
+  // `count` buckets from bucket `first`; ones past the end read as 0
+  read(name, first, count) {
+    const { width } = RESOLUTIONS[name];
+    const buf = Buffer.alloc(count * width);
+    if (count > 0) fs.readSync(this.fds[name], buf, 0, buf.length, first * width);
+    return buf;
+  }
+
+  // Nothing is recorded before the epoch or after `now`: [from, to) cut to that
+  bounds(from, to, now) {
+    from = Math.max(from, this.epoch);
+    return { from, to: Math.max(from, Math.min(to, now)) };
+  }
+
+  // Occupied ms per bucket over [from, to), including the run in progress.
+  // The range is cut to bounds() first, as every bucket in it is allocated.
+  series(name, from, to, now) {
+    ({ from, to } = this.bounds(from, to, now));
+    const { step, width } = RESOLUTIONS[name];
+    const first = Math.floor((from - this.epoch) / step);
+    const count = to > from ? Math.ceil((to - this.epoch) / step) - first : 0;
+    const buf = this.read(name, first, count);
+    const occupied = new Array(count);
+    for (let i = 0; i < count; i++) {
+      occupied[i] = width === 2 ? buf.readUInt16LE(i * width) : buf.readUInt32LE(i * width);
+    }
+    if (this.presence) {
+      // Not in the rollups yet
+      for (let i = 0; i < count; i++) {
+        const start = this.epoch + (first + i) * step;
+        const ms = Math.min(now, start + step) - Math.max(this.accountedUntil, start);
+        if (ms > 0) occupied[i] = Math.min(step, occupied[i] + ms);
+      }
+    }
+    return { from: this.epoch + first * step, step, occupied };
+  }
+
+  // Occupied ms in [from, to): whole hours from h1, the ragged ends from m1
+  total(from, to, now) {
+    from = Math.floor(from / MINUTE) * MINUTE;
+    to = Math.ceil(to / MINUTE) * MINUTE;
+    const hourFrom = Math.ceil((from - this.epoch) / HOUR) * HOUR + this.epoch;
+    const hourTo = Math.floor((to - this.epoch) / HOUR) * HOUR + this.epoch;
+    const sum = (s) => s.occupied.reduce((a, b) => a + b, 0);
+    if (hourTo <= hourFrom) return sum(this.series("1m", from, to, now));
+    return sum(this.series("1m", from, hourFrom, now)) + sum(this.series("1h", hourFrom, hourTo, now)) +
+      sum(this.series("1m", hourTo, to, now));
+  }
+
+  // Presence changes in [from, to) as [t, presence] pairs
+  events(from, to) {
+    if (!fs.existsSync(this.eventsPath)) return [];
+    const buf = fs.readFileSync(this.eventsPath);
+    const out = [];
+    const pos = { off: 0 };
+    let t = 0;
+    let delta = 0;
+    let presence = false;
+    while (pos.off < buf.length) {
+      if (buf[pos.off] === CHUNK_START) {
+        pos.off++;
+        const t0 = readUvarint(buf, pos);
+        if (t0 === null || pos.off >= buf.length) break;    // torn write at the tail
+        t = t0;
+        delta = 0;
+        presence = buf[pos.off++] === 1;
+      } else {
+        const dod = readUvarint(buf, pos);
+        if (dod === null) break;
+        delta += unzigzag(dod - 1);
+        t += delta;
+        presence = !presence;
+      }
+      if (t >= to) break;
+      if (t >= from) out.push([t, presence]);
+    }
+    return out;
+  }
+
+  close() {
+    for (const fd of Object.values(this.fds)) fs.closeSync(fd);
+  }
+}
+
+export class HistoryStore {
+  constructor(dir) {
+    this.dir = dir;
+    this.sensors = new Map();
+  }
+
+  open(sensorId, create) {
+    let history = this.sensors.get(sensorId);
+    if (!history) {
+      const dir = path.join(this.dir, encodeURIComponent(sensorId));
+      if (!create && !fs.existsSync(dir)) return null;
+      history = new SensorHistory(dir);
+      this.sensors.set(sensorId, history);
+    }
+    return history;
+  }
+
+  record(sensorId, t, presence) {
+    this.open(sensorId, true).record(t, presence);
+  }
+
+  // Every minute: occupied time so far goes into the rollups, so a crash
+  // loses at most a minute of it
+  flush(now = Date.now()) {
+    for (const history of this.sensors.values()) {
+      if (history.presence) history.account(now);
+    }
+  }
+
+  // Sensors with history on disk, also those not seen since the last start
+  ids() {
+    if (!fs.existsSync(this.dir)) return [];
+    return fs.readdirSync(this.dir).map(decodeURIComponent);
+  }
+
+  // [from, to) cut to what the sensor can have recorded, null without history
+  bounds(sensorId, from, to, now = Date.now()) {
+    return this.open(sensorId, false)?.bounds(from, to, now) ?? null;
+  }
+
+  // `step` is a RESOLUTIONS key; without one the finest that keeps the
+  // series under MAX_POINTS is used
+  series(sensorId, from, to, step, now = Date.now()) {
+    const history = this.open(sensorId, false);
+    if (!history) return null;
+    ({ from, to } = history.bounds(from, to, now));
+    step ??= Object.keys(RESOLUTIONS).find((k) => (to - from) / RESOLUTIONS[k].step <= MAX_POINTS) ?? "1h";
+    return history.series(step, from, to, now);
+  }
+
+  total(sensorId, from, to, now = Date.now()) {
+    return this.open(sensorId, false)?.total(from, to, now) ?? 0;
+  }
+
+  events(sensorId, from, to) {
+    return this.open(sensorId, false)?.events(from, to) ?? null;
+  }
+
+  close() {
+    this.flush();
+    for (const history of this.sensors.values()) history.close();
+  }
+}
+
+function zigzag(n) {
+  return n >= 0 ? n * 2 : -n * 2 - 1;
+}
+
+function unzigzag(z) {
+  return z % 2 === 0 ? z / 2 : -(z + 1) / 2;
+}
+
+// Plain arithmetic rather than bit ops: timestamps do not fit in 32 bits
+function writeUvarint(out, n) {
+  while (n >= 0x80) {
+    out.push((n % 0x80) | 0x80);
+    n = Math.floor(n / 0x80);
+  }
+  out.push(n);
+}
+
+// Returns null if the buffer ends mid-varint
+function readUvarint(buf, pos) {
+  let n = 0;
+  let scale = 1;
+  while (pos.off < buf.length) {
+    const b = buf[pos.off++];
+    n += (b & 0x7f) * scale;
+    if (b < 0x80) return n;
+    scale *= 0x80;
+  }
+  return null;
+}
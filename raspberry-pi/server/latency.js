@@ -0,0 +1,185 @@
+// End-to-end latency tracing: ESP32 -> server -> dashboard.
+//
+// Every stage of a sample is stamped on the monotonic clock of whoever
+// handles it (ESP32 micros(), server and browser performance.now()) and
+// keyed by sensorId + seq. A ClockSync per connection maps remote stamps
+// onto the server clock; it is fed by the heartbeat: the server sends
+// { type: "heartbeat", mono: t1 } and the peer answers at once with
+// { type: "clock", t1, t2: received, t3: replied } in its own clock. Peers
+// only read the socket every few ms, so each heartbeat is a short burst of
+// CLOCK_PROBES probes and the fastest round trip is used.
+//
+// Hops, all in ms:
+//   device.queue      frame complete -> queued to the network task   (ESP32 clock)
+//   device.send       queued -> sendFrame done                       (ESP32 clock)
+//   uplink            sendFrame done -> ws "message" on the server
+//   server.derive     "message" -> presence derived
+//   server.broadcast  derived -> broadcast() returned
+//   downlink          broadcast -> dashboard onmessage
+//   browser.dom       onmessage -> DOM updated                       (browser clock)
+//   browser.paint     DOM updated -> next animation frame            (browser clock)
+//   total             frame complete -> next animation frame
+//
+// Only a sample of seqs is traced: those divisible by TRACE_EVERY
+// (LATENCY_TRACE_EVERY, default 32, the same default as the firmware's).
+// The server marks them "traced" in what it publishes and only dashboards
+// that get such a message report back, so tracing costs the uplink and the
+// Pi about 1/TRACE_EVERY of a message per sample and dashboard.
+//
+// uplink, downlink and total cross clocks and are only good to about half
+// the peer's sync round trip (clocks[].rttMs in /api/latency); readings
+// that land below zero within that error are counted as zero.
+
+const HOPS = [
+  "device.queue",
+  "device.send",
+  "uplink",
+  "server.derive",
+  "server.broadcast",
+  "downlink",
+  "browser.dom",
+  "browser.paint",
+  "total",
+];
+
+const WINDOW = 1000;        // latest values kept per hop
+const MAX_PENDING = 4096;   // traces waiting for their other halves
+export const CLOCK_PROBES = 4;           // per heartbeat
+const CLOCK_SAMPLES = 2 * CLOCK_PROBES;  // replies considered; the fastest wins
+
+export const TRACE_EVERY = Math.max(1, Number(process.env.LATENCY_TRACE_EVERY ?? 32));
+export const isTraced = (seq) => seq % TRACE_EVERY === 0;
+
+export const now = () => performance.now();
+
+// Maps a peer's monotonic clock onto ours. `scale` is ms per remote unit;
+// `wrap` is the remote counter width in bits (ESP32 micros() is 32-bit).
+export class ClockSync {
+  constructor(scale = 1, wrap = 0) {
+    this.scale = scale;
+    this.wrap = wrap ? 2 ** wrap : 0;
+    this.samples = [];
+    this.best = null;
+  }
+
+  // NTP-style: t1/t4 are ours, t2/t3 the peer's. The reply with the least
+  // network delay gives the tightest bound, so keep the fastest recent one.
+  update(t1, t2, t3, t4) {
+    const delay = (t4 - t1) - this.delta(t3, t2) * this.scale;
+    if (!(delay >= 0)) return;
+    this.samples.push({ remote: t2, local: t1 + delay / 2, delay, at: t4 });
+    if (this.samples.length > CLOCK_SAMPLES) this.samples.shift();
+    this.best = this.samples.reduce((a, b) => (b.delay <= a.delay ? b : a));
+  }
+
+  // Only after a full burst; a lone probe can be far off
+  get synced() {
+    return this.samples.length >= CLOCK_PROBES;
+  }
+
+  get rtt() {
+    return this.best ? this.best.delay : null;
+  }
+
+  // Remote stamp -> server ms
+  toLocal(t) {
+    return this.best.local + this.delta(t, this.best.remote) * this.scale;
+  }
+
+  delta(a, b) {
+    let d = a - b;
+    if (this.wrap) {
+      d = ((d % this.wrap) + this.wrap) % this.wrap;
+      if (d >= this.wrap / 2) d -= this.wrap;
+    }
+    return d;
+  }
+}
+
+export class LatencyTracker {
+  constructor() {
+    this.hops = new Map(HOPS.map((h) => [h, []]));
+    this.pending = new Map();
+  }
+
+  record(hop, ms) {
+    if (!Number.isFinite(ms) || ms < 0) return;
+    this.push(hop, ms);
+  }
+
+  // Cross-clock hop, see the note at the top
+  recordSynced(hop, ms, clock) {
+    if (!Number.isFinite(ms) || ms < -clock.rtt / 2 - 1) return;
+    this.push(hop, Math.max(0, ms));
+  }
+
+  push(hop, ms) {
+    const values = this.hops.get(hop);
+    values.push(ms);
+    if (values.length > WINDOW) values.shift();
+  }
+
+  entry(sensorId, seq) {
+    const key = sensorId + ":" + seq;
+    let e = this.pending.get(key);
+    if (!e) {
+      e = { server: null, frame: null, paints: [] };
+      this.pending.set(key, e);
+      if (this.pending.size > MAX_PENDING) this.pending.delete(this.pending.keys().next().value);
+    }
+    return e;
+  }
+
+  // Server stages of one live sample: rx = ws "message", then presence
+  // derived, then broadcast() returned
+  server(sensorId, seq, rx, derived, broadcast) {
+    const e = this.entry(sensorId, seq);
+    e.server = { rx, broadcast };
+    this.record("server.derive", derived - rx);
+    this.record("server.broadcast", broadcast - derived);
+  }
+
+  // {"type":"trace","sent":us,"samples":[[seq,frameUs,queuedUs],...]} from an ESP32
+  device(sensorId, clock, msg) {
+    if (!Array.isArray(msg.samples)) return;
+    for (const [seq, frameUs, queuedUs] of msg.samples) {
+      this.record("device.queue", clock.delta(queuedUs, frameUs) * clock.scale);
+      this.record("device.send", clock.delta(msg.sent, queuedUs) * clock.scale);
+      if (!clock.synced) continue;
+
+      const e = this.entry(sensorId, seq);
+      e.frame = clock.toLocal(frameUs);
+      if (e.server) this.recordSynced("uplink", e.server.rx - clock.toLocal(msg.sent), clock);
+      for (const paint of e.paints) this.recordSynced("total", paint - e.frame, clock);
+    }
+  }
+
+  // {"type":"trace","sensorId","seq","rx","dom","paint"} from a dashboard
+  browser(clock, msg) {
+    this.record("browser.dom", msg.dom - msg.rx);
+    this.record("browser.paint", msg.paint - msg.dom);
+    if (!clock.synced) return;
+
+    const e = this.entry(msg.sensorId, msg.seq);
+    const paint = clock.toLocal(msg.paint);
+    if (e.server) this.recordSynced("downlink", clock.toLocal(msg.rx) - e.server.broadcast, clock);
+    if (e.frame !== null) this.recordSynced("total", paint - e.frame, clock);
+    else e.paints.push(paint);
+  }
+
+  stats() {
+    const hops = {};
+    for (const [hop, values] of this.hops) {
+      const sorted = [...values].sort((a, b) => a - b);
+      const pick = (p) => round(sorted[Math.min(sorted.length - 1, Math.round(p * (sorted.length - 1)))]);
+      hops[hop] = sorted.length
+        ? { count: sorted.length, p50: pick(0.5), p95: pick(0.95), p99: pick(0.99), max: round(sorted[sorted.length - 1]) }
+        : { count: 0 };
+    }
+    return hops;
+  }
+}
+
+function round(ms) {
+  return Math.round(ms * 1000) / 1000;
+}
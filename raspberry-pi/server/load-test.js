@@ -0,0 +1,251 @@
+// Load generator and soak test for server.js.
+//
+// Simulates N ESP32 sensors and M dashboards against a running server and
+// reports every few seconds, then for the whole run:
+//   ingest   samples/s sent, filed by the server (/api/metrics) and acked
+//   fan-out  dashboard messages/s and sensor send -> dashboard receive
+//            latency, p50/p95/p99 (both ends run here, on one clock)
+//   server   CPU %, RSS and event loop delay (/api/metrics)
+//
+//   node load-test.js --sensors 50 --dashboards 10 --rate 10 --burst 8 --duration 600
+//
+//   --sensors N         virtual sensors (20)
+//   --dashboards M      dashboard connections (5)
+//   --rate HZ           samples per second per sensor (10)
+//   --burst B           samples sent together every B/rate s: one telemetry
+//                       packet for binary, as the ESP32 batches, otherwise
+//                       B messages back to back (1)
+//   --jitter F          random spread of each send interval, 0..1 (0.2)
+//   --format F          binary | json | kv | csv (binary)
+//   --flip P            chance a sample flips its sensor's presence (0.05)
+//   --dashboard-rate R  raw lines/s each dashboard subscribes to (1000)
+//   --duration S        length of the run in seconds (60)
+//   --every S           report interval in seconds (5)
+//   --url URL           ws://localhost:3000/ws
+//
+// Run it from another machine than the Pi for numbers that are the Pi's
+// alone; if this process saturates, its own event loop shows up as fan-out
+// latency.
+
+import { WebSocket } from "ws";
+import { encodeTelemetry } from "./telemetry.js";
+
+const DEFAULTS = {
+  sensors: 20,
+  dashboards: 5,
+  rate: 10,
+  burst: 1,
+  jitter: 0.2,
+  format: "binary",
+  flip: 0.05,
+  "dashboard-rate": 1000,
+  duration: 60,
+  every: 5,
+  url: "ws://localhost:3000/ws",
+};
+const FORMATS = ["binary", "json", "kv", "csv"];
+const PENDING_MS = 30000;      // sends older than this are no longer matched
+
+function parseArgs(argv) {
+  const opts = { ...DEFAULTS };
+  for (let i = 0; i < argv.length; i++) {
+    const key = argv[i].replace(/^--/, "");
+    if (!(key in DEFAULTS) || i + 1 >= argv.length) {
+      console.error("Unknown or incomplete option:", argv[i]);
+      process.exit(1);
+    }
+    const value = argv[++i];
+    opts[key] = typeof DEFAULTS[key] === "number" ? Number(value) : value;
+  }
+  if (!FORMATS.includes(opts.format)) {
+    console.error("--format is one of", FORMATS.join(", "));
+    process.exit(1);
+  }
+  return opts;
+}
+
+const opts = parseArgs(process.argv.slice(2));
+const metricsUrl = opts.url.replace(/^ws/, "http").replace(/\/ws$/, "/api/metrics");
+
+const sentAt = new Map();      // "sensorId:seq" -> performance.now() at send
+const totals = { sent: 0, acked: 0, received: 0, latencies: [] };
+let window_ = { sent: 0, acked: 0, received: 0, latencies: [] };
+
+function record(key, value) {
+  window_[key] += value;
+  totals[key] += value;
+}
+
+// ----- Sensors -----
+
+function textMessage(sensorId, sample) {
+  const n = sample.targets.length;
+  switch (opts.format) {
+    case "json":
+      return JSON.stringify({
+        sensorId, seq: sample.seq, prev: sample.seq - 1, ts: sample.ts,
+        targets: sample.targets.map((t) => [t.x, t.y, t.speed, t.distance]),
+      });
+    case "kv":
+      return JSON.stringify({ sensorId, raw: "targets=" + n + " seq=" + sample.seq });
+    case "csv":
+      return JSON.stringify({ sensorId, raw: sample.ts + "," + n + "," + sample.seq });
+  }
+}
+
+function startSensor(index) {
+  const sensorId = "load-" + index;
+  const ws = new WebSocket(opts.url);
+  const period = (1000 * opts.burst) / opts.rate;
+  let seq = 0;
+  let acked = 0;
+  let present = false;
+  let timer = null;
+
+  const sample = () => {
+    if (Math.random() < opts.flip) present = !present;
+    const targets = present ? [{ x: 120, y: 1500, speed: 0, distance: 1505 }] : [];
+    return { seq: ++seq, ts: Date.now() >>> 0, targets };
+  };
+
+  const send = () => {
+    const samples = Array.from({ length: opts.burst }, sample);
+    const now = performance.now();
+    for (const s of samples) sentAt.set(sensorId + ":" + s.seq, now);
+    // Nothing is resent, so each packet follows the one before
+    if (opts.format === "binary") ws.send(encodeTelemetry(sensorId, samples, 0, samples[0].seq - 1));
+    else for (const s of samples) ws.send(textMessage(sensorId, s));
+    record("sent", samples.length);
+    timer = setTimeout(send, period * (1 + opts.jitter * (Math.random() * 2 - 1)));
+  };
+
+  // Spread the first sends so the sensors do not all fire at once
+  ws.on("open", () => {
+    timer = setTimeout(send, Math.random() * period);
+  });
+  ws.on("message", (data, isBinary) => {
+    if (isBinary) return;
+    const msg = JSON.parse(data.toString());
+    if (msg.type === "ack" && msg.seq > acked) {
+      record("acked", msg.seq - acked);
+      acked = msg.seq;
+    }
+  });
+  ws.on("error", (err) => console.error(sensorId, err.message));
+  return { ws, stop: () => clearTimeout(timer) };
+}
+
+// ----- Dashboards -----
+
+// Binary and JSON samples come back with their seq; raw lines carry it in
+// the text we made up above
+function seqOf(msg) {
+  if (msg.seq !== undefined) return msg.seq;
+  const raw = msg.raw ?? msg.lastRaw ?? "";
+  const m = /seq=(\d+)$/.exec(raw) ?? /,(\d+)$/.exec(raw);
+  return m ? Number(m[1]) : undefined;
+}
+
+// Dashboards answer heartbeats and report traced messages like script.js,
+// so the run includes what the latency trace costs the server
+function startDashboard() {
+  const ws = new WebSocket(opts.url + "?rate=" + opts["dashboard-rate"]);
+  ws.on("message", (data) => {
+    const now = performance.now();
+    const msg = JSON.parse(data.toString());
+    if (msg.type === "heartbeat" && msg.mono !== undefined) {
+      ws.send(JSON.stringify({ type: "clock", t1: msg.mono, t2: now, t3: performance.now() }));
+      return;
+    }
+    if (msg.type !== "state" && msg.type !== "raw") return;
+    if (msg.traced) {
+      ws.send(JSON.stringify({ type: "trace", sensorId: msg.sensorId, seq: msg.seq, rx: now, dom: now, paint: performance.now() }));
+    }
+    record("received", 1);
+    const t = sentAt.get(msg.sensorId + ":" + seqOf(msg));
+    if (t !== undefined) {
+      window_.latencies.push(now - t);
+      if (totals.latencies.length < 1e6) totals.latencies.push(now - t);
+    }
+  });
+  ws.on("error", (err) => console.error("dashboard", err.message));
+  return { ws, stop: () => {} };
+}
+
+// ----- Reporting -----
+
+function percentiles(values) {
+  if (!values.length) return "   -      -      -   ";
+  const sorted = Float64Array.from(values).sort();
+  const at = (p) => sorted[Math.min(sorted.length - 1, Math.round(p * (sorted.length - 1)))].toFixed(1).padStart(6);
+  return at(0.5) + " " + at(0.95) + " " + at(0.99);
+}
+
+async function metrics() {
+  try {
+    const res = await fetch(metricsUrl);
+    return await res.json();
+  } catch {
+    return null;
+  }
+}
+
+function cpuPercent(a, b) {
+  if (!a || !b) return "  -";
+  const used = (b.cpu.user + b.cpu.system - a.cpu.user - a.cpu.system) / 1e3;
+  return ((100 * used) / ((b.uptime - a.uptime) * 1000)).toFixed(0).padStart(3);
+}
+
+function line(label, seconds, w, filed, m0, m1) {
+  const rate = (n) => (n / seconds).toFixed(0).padStart(6);
+  const server = m1
+    ? `cpu ${cpuPercent(m0, m1)}%  rss ${(m1.rss / 1048576).toFixed(0).padStart(4)} MB  loop p99 ${m1.loopDelay.p99.toFixed(1).padStart(5)} ms`
+    : "server metrics unavailable";
+  return `${label}  sent ${rate(w.sent)}/s  filed ${filed === null ? "     -" : rate(filed)}/s  acked ${rate(w.acked)}/s  ` +
+    `fan-out ${rate(w.received)}/s  p50/p95/p99 ${percentiles(w.latencies)} ms  ${server}`;
+}
+
+async function main() {
+  console.log(
+    `${opts.sensors} sensors x ${opts.rate} Hz (burst ${opts.burst}, ${opts.format}), ` +
+    `${opts.dashboards} dashboards, ${opts.duration} s against ${opts.url}`,
+  );
+  const first = await metrics();
+  let last = first;
+  let maxRss = first?.rss ?? 0;
+
+  const peers = [];
+  for (let i = 0; i < opts.dashboards; i++) peers.push(startDashboard());
+  for (let i = 0; i < opts.sensors; i++) peers.push(startSensor(i));
+
+  const start = performance.now();
+  let elapsed = 0;
+  while (elapsed < opts.duration) {
+    await new Promise((r) => setTimeout(r, opts.every * 1000));
+    elapsed = Math.round((performance.now() - start) / 1000);
+    const m = await metrics();
+    const filed = m && last ? m.samples - last.samples : null;
+    if (m) maxRss = Math.max(maxRss, m.rss);
+    console.log(line(`t=${String(elapsed).padStart(4)}s`, opts.every, window_, filed, last, m));
+    window_ = { sent: 0, acked: 0, received: 0, latencies: [] };
+    if (m) last = m;
+
+    const horizon = performance.now() - PENDING_MS;
+    for (const [key, t] of sentAt) {
+      if (t >= horizon) break;
+      sentAt.delete(key);
+    }
+  }
+
+  for (const peer of peers) {
+    peer.stop();
+    peer.ws.close();
+  }
+  const seconds = (performance.now() - start) / 1000;
+  const filed = first && last ? last.samples - first.samples : null;
+  console.log(line("total ", seconds, totals, filed, first, last));
+  console.log(`max rss ${(maxRss / 1048576).toFixed(0)} MB, ${totals.latencies.length} fan-out deliveries timed`);
+  setTimeout(() => process.exit(0), 200);
+}
+
+main();
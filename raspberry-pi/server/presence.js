@@ -0,0 +1,130 @@
+// Presence derivation for text sensor lines (binary telemetry never gets
+// here; see telemetry.js).
+//
+// A sensor sticks to one output format, so each connection gets a
+// PresenceParser that works the format out from the first line and from
+// then on runs only that format's parser: no JSON.parse on lines that
+// cannot be JSON, and no exceptions on the hot path. A line the format
+// parser does not understand still gets full detection, so mixed streams
+// are read correctly; after MAX_MISSES of those in a row the format is
+// detected again.
+
+const MAX_MISSES = 3;
+
+const JSON_COUNT_FIELDS = ["targets", "targetCount", "count"];
+const KV = /\b(targets?|count)\s*=\s*(\d+)/i;
+const DIGITS = /^\d+$/;
+const KEYWORDS = /\b(person|human|occupied|presence|target)\b/i;
+
+// One parser per format. Each returns true/false, or undefined if the line
+// is not in its format. `obj` is the line already parsed as JSON, if the
+// caller did that anyway.
+const FORMATS = {
+  json(line, obj) {
+    if (obj === undefined) obj = parseJsonObject(line);
+    if (!obj) return undefined;
+    for (const k of JSON_COUNT_FIELDS) {
+      if (typeof obj[k] === "number") return obj[k] > 0;
+    }
+    if (typeof obj.presence === "boolean") return obj.presence;
+    if (typeof obj.occupied === "boolean") return obj.occupied;
+    return undefined;
+  },
+
+  // targets=1
+  kv(line) {
+    const m = KV.exec(line);
+    return m ? parseInt(m[2], 10) > 0 : undefined;
+  },
+
+  // Second field is the target count: "ts,1,..." or "ts;1;..."
+  csv(line) {
+    const start = nextSeparator(line, 0);
+    if (start < 0) return undefined;
+    let end = nextSeparator(line, start + 1);
+    if (end < 0) end = line.length;
+    const field = line.slice(start + 1, end).trim();
+    return DIGITS.test(field) ? parseInt(field, 10) > 0 : undefined;
+  },
+
+  // Free text: any presence keyword
+  text(line) {
+    return KEYWORDS.test(line);
+  },
+};
+
+const startsJson = (line) => line.charCodeAt(0) === 0x7b;   // "{"
+
+// Lines a locked-in format must leave to detection because an earlier
+// format in DETECT_ORDER may claim them
+const EARLIER = {
+  json: () => false,
+  kv: startsJson,
+  csv: (line) => startsJson(line) || line.includes("="),
+  text: (line) => /[{=,;]/.test(line),
+};
+
+const DETECT_ORDER = ["json", "kv", "csv"];
+
+// Returns the parsed object if `text` is a JSON object, else undefined.
+// Only text that starts with "{" is handed to JSON.parse, so plain sensor
+// lines never throw.
+export function parseJsonObject(text) {
+  let i = 0;
+  while (i < text.length && text.charCodeAt(i) <= 0x20) i++;
+  if (text.charCodeAt(i) !== 0x7b) return undefined;
+  try {
+    const obj = JSON.parse(text);
+    return obj && typeof obj === "object" ? obj : undefined;
+  } catch {
+    return undefined;
+  }
+}
+
+function nextSeparator(line, from) {
+  for (let i = from; i < line.length; i++) {
+    const c = line.charCodeAt(i);
+    if (c === 0x2c || c === 0x3b) return i;   // "," ";"
+  }
+  return -1;
+}
+
+// Tries every format in order; the keyword test is the catch-all.
+function detect(line, obj) {
+  for (const format of DETECT_ORDER) {
+    const presence = FORMATS[format](line, obj);
+    if (presence !== undefined) return { format, presence };
+  }
+  return { format: "text", presence: KEYWORDS.test(line) };
+}
+
+// One-off derivation for a trimmed line (e.g. /api/inject)
+export function derivePresence(line) {
+  return line ? detect(line).presence : false;
+}
+
+export class PresenceParser {
+  constructor() {
+    this.format = null;
+    this.misses = 0;
+  }
+
+  // `line` is trimmed; `obj` is passed if the caller already parsed it as JSON
+  parse(line, obj) {
+    if (!line) return false;
+    if (this.format) {
+      const presence = EARLIER[this.format](line) ? undefined : FORMATS[this.format](line, obj);
+      if (presence !== undefined) {
+        this.misses = 0;
+        return presence;
+      }
+      if (++this.misses >= MAX_MISSES) this.format = null;
+    }
+    const detected = detect(line, obj);
+    if (!this.format) {
+      this.format = detected.format;
+      this.misses = 0;
+    }
+    return detected.presence;
+  }
+}
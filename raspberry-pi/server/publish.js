@@ -0,0 +1,208 @@
+// Fan-out of updates to dashboards.
+//
+// A message is serialized once, on its first recipient, into a Buffer all
+// recipients share (ws frames it per socket without copying it). A peer is
+// a dashboard once it subscribes, on connect (/ws?sensors=a,b&zones=east&rate=10)
+// or later with {"type":"subscribe", sensors, zones, rate}; sensors never
+// do and get nothing from here. Recipients are found through per-sensor and
+// per-zone indexes, so a publish costs
+// O(recipients), not O(clients).
+//
+// Delivery by kind:
+//   state  always delivered, but a client whose socket is backed up only has
+//          the sensor marked stale; once it drains it gets that sensor's
+//          latest state, skipping everything in between
+//   raw    log lines: at most `rate` per second per client (0 = none),
+//          dropped while backed up
+//   event  anything else (replayed history), dropped while backed up
+
+import { WebSocket } from "ws";
+
+const HIGH_WATER = 256 * 1024;   // bufferedAmount above which a client is lagging
+const LOW_WATER = 32 * 1024;     // ... and below which it has caught up
+const DEFAULT_RAW_RATE = 10;     // raw lines/s for clients that do not say
+const DRAIN_CHECK_MS = 250;
+
+class Subscriber {
+  constructor(ws, peer) {
+    this.ws = ws;
+    this.peer = peer;
+    this.sensors = null;   // Set of sensorIds, null = all
+    this.zones = null;     // Set of zones
+    this.rawInterval = 1000 / DEFAULT_RAW_RATE;
+    this.nextRaw = 0;
+    this.lagging = false;
+    this.stale = new Set();
+    this.mark = 0;         // last publish delivered, to skip duplicates
+    this.sent = 0;
+    this.dropped = 0;
+    this.throttled = 0;
+  }
+
+  get everything() {
+    return !this.sensors && !this.zones;
+  }
+}
+
+export class Publisher {
+  // `latestState(sensorId)` returns the state message to send a client that
+  // missed updates of that sensor
+  constructor(latestState) {
+    this.latestState = latestState;
+    this.clients = new Map();       // ws -> Subscriber
+    this.everything = new Set();
+    this.bySensor = new Map();      // sensorId -> Set<Subscriber>
+    this.byZone = new Map();        // zone -> Set<Subscriber>
+    this.lagging = new Set();
+    this.mark = 0;
+    setInterval(() => this.checkLagging(), DRAIN_CHECK_MS).unref();
+  }
+
+  // `query` is the connect URL's search params, if any
+  add(ws, peer, query) {
+    const sub = new Subscriber(ws, peer);
+    this.clients.set(ws, sub);
+    const list = (key) => query?.get(key)?.split(",").filter(Boolean);
+    this.subscribe(ws, { sensors: list("sensors"), zones: list("zones"), rate: query?.get("rate") });
+  }
+
+  has(ws) {
+    return this.clients.has(ws);
+  }
+
+  remove(ws) {
+    const sub = this.clients.get(ws);
+    if (!sub) return;
+    this.unindex(sub);
+    this.lagging.delete(sub);
+    this.clients.delete(ws);
+  }
+
+  // {"type":"subscribe","sensors":[...],"zones":[...],"rate":hz}; no sensors
+  // and no zones means everything
+  subscribe(ws, { sensors, zones, rate }) {
+    const sub = this.clients.get(ws);
+    if (!sub) return;
+    this.unindex(sub);
+    sub.sensors = Array.isArray(sensors) && sensors.length ? new Set(sensors.map(String)) : null;
+    sub.zones = Array.isArray(zones) && zones.length ? new Set(zones.map(String)) : null;
+    if (rate !== undefined && rate !== null && rate !== "") {
+      const hz = Number(rate);
+      if (hz >= 0) {
+        sub.rawInterval = hz > 0 ? 1000 / hz : Infinity;
+        sub.nextRaw = hz > 0 ? 0 : Infinity;
+      }
+    }
+    if (sub.everything) this.everything.add(sub);
+    for (const id of sub.sensors ?? []) index(this.bySensor, id).add(sub);
+    for (const zone of sub.zones ?? []) index(this.byZone, zone).add(sub);
+  }
+
+  wants(ws, sensorId, zone) {
+    const sub = this.clients.get(ws);
+    return !!sub && (sub.everything || !!sub.sensors?.has(sensorId) || (zone !== null && !!sub.zones?.has(zone)));
+  }
+
+  publish(kind, sensorId, zone, obj) {
+    const mark = ++this.mark;
+    const t = performance.now();
+    let data = null;
+    const deliver = (sub) => {
+      if (sub.mark === mark) return;
+      sub.mark = mark;
+      if (sub.ws.readyState !== WebSocket.OPEN) return;
+
+      if (this.backedUp(sub)) {
+        if (kind === "state") {
+          sub.stale.add(sensorId);
+          this.lagging.add(sub);
+        }
+        sub.dropped++;
+        return;
+      }
+      if (kind === "state") sub.stale.delete(sensorId);
+      if (sub.stale.size) this.catchUp(sub);
+      if (kind === "raw") {
+        if (t < sub.nextRaw) {
+          sub.throttled++;
+          return;
+        }
+        sub.nextRaw = t + sub.rawInterval;
+      }
+      data ??= Buffer.from(JSON.stringify(obj));
+      sub.ws.send(data, { binary: false });
+      sub.sent++;
+    };
+
+    for (const sub of this.everything) deliver(sub);
+    this.bySensor.get(sensorId)?.forEach(deliver);
+    if (zone !== null) this.byZone.get(zone)?.forEach(deliver);
+  }
+
+  // Lagging with hysteresis, so a client hovering at the mark does not flap
+  backedUp(sub) {
+    const buffered = sub.ws.bufferedAmount;
+    if (sub.lagging) {
+      if (buffered < LOW_WATER) sub.lagging = false;
+    } else if (buffered > HIGH_WATER) {
+      sub.lagging = true;
+    }
+    return sub.lagging;
+  }
+
+  catchUp(sub) {
+    for (const sensorId of sub.stale) {
+      const obj = this.latestState(sensorId);
+      if (obj) {
+        sub.ws.send(JSON.stringify(obj));
+        sub.sent++;
+      }
+    }
+    sub.stale.clear();
+    this.lagging.delete(sub);
+  }
+
+  // Clients that drained while their sensors were quiet
+  checkLagging() {
+    for (const sub of this.lagging) {
+      if (sub.ws.readyState !== WebSocket.OPEN) this.lagging.delete(sub);
+      else if (!this.backedUp(sub)) this.catchUp(sub);
+    }
+  }
+
+  unindex(sub) {
+    this.everything.delete(sub);
+    for (const id of sub.sensors ?? []) unindex(this.bySensor, id, sub);
+    for (const zone of sub.zones ?? []) unindex(this.byZone, zone, sub);
+  }
+
+  stats() {
+    return [...this.clients.values()].map((sub) => ({
+      peer: sub.peer,
+      sensors: sub.sensors && [...sub.sensors],
+      zones: sub.zones && [...sub.zones],
+      rate: sub.rawInterval === Infinity ? 0 : 1000 / sub.rawInterval,
+      sent: sub.sent,
+      throttled: sub.throttled,
+      dropped: sub.dropped,
+      buffered: sub.ws.bufferedAmount,
+      lagging: sub.lagging,
+    }));
+  }
+}
+
+function index(map, key) {
+  let set = map.get(key);
+  if (!set) {
+    set = new Set();
+    map.set(key, set);
+  }
+  return set;
+}
+
+function unindex(map, key, sub) {
+  const set = map.get(key);
+  if (!set) return;
+  set.delete(sub);
+  if (!set.size) map.delete(key);
+}
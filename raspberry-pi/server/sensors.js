@@ -0,0 +1,208 @@
+// Per-sensor presence state, keyed by sensorId.
+//
+// A reading costs O(1) however many sensors share the server: one Map
+// lookup, the sensor's own debounce and counters, and an occupied count
+// that is adjusted on every flip, so floor-wide presence never needs a scan.
+//
+// Debounce: presence turns on with the first reading that sees someone, but
+// only turns off once nobody was seen for PRESENCE_HOLD_MS, so a radar that
+// briefly loses a person sitting still does not flicker. 0 turns it off.
+// Replayed readings are debounced the same way, by their own timestamps.
+
+const HOLD_MS = Number(process.env.PRESENCE_HOLD_MS ?? 1000);
+
+// Packets past a gap a sensor can have outstanding before more are no
+// longer remembered (they are still filed, but would be filed again)
+const MAX_AHEAD = 64;
+
+// Boots of a device whose clock offset is remembered
+const MAX_BOOTS = 4;
+
+export class Sensor {
+  constructor(id, zone) {
+    this.id = id;
+    this.zone = zone;
+    this.presence = false;
+    this.lastRaw = "";
+    this.lastUpdate = null;   // ISO time of the last presence change
+    this.lastSeen = null;
+    this.targets = undefined;
+    this.acked = 0;           // seqs received without a gap up to here
+    this.ahead = [];          // [prevSeq, lastSeq] of packets past a gap
+    this.samples = 0;
+    this.changes = 0;
+    this.replayed = 0;
+    this.vacantSince = null;  // held-off vacancy: when nobody was seen first
+    this.vacantTimer = null;
+    this.boots = new Map();   // first seq of a boot -> { offset, next }
+    this.boot = null;         // the device's current boot
+  }
+
+  // Sample timestamps are the device's millis(), which restart with every
+  // boot; a boot is named by the first seq the device issued in it. On each
+  // connection the device names its boot and the one before and says how
+  // long it has been up, which pins its millis() 0 to wall time.
+  hello(boot, prevBoot, uptime, at) {
+    this.boots.set(boot, { offset: at - uptime, next: this.boots.get(boot)?.next ?? null });
+    const prev = this.boots.get(prevBoot);
+    if (prev && prevBoot !== boot) prev.next = boot;
+    this.boot = boot;
+    while (this.boots.size > MAX_BOOTS) this.boots.delete(this.boots.keys().next().value);
+  }
+
+  // Wall time (ms) of a sample, or null if the boot it was taken in is unknown
+  wallTime(seq, ts) {
+    let first = -1;
+    for (const boot of this.boots.keys()) {
+      if (boot <= seq && boot > first) first = boot;
+    }
+    const boot = this.boots.get(first);
+    if (!boot) return null;
+    if (boot.next === null ? first !== this.boot : seq >= boot.next) return null;
+    return boot.offset + ts;
+  }
+
+  // Store-and-forward bookkeeping for one packet (see esp32/src/sample_log.h).
+  // Each packet names the seq before its first sample in the device's log,
+  // 0 if none is left there, so what arrived forms a chain; `acked` is where
+  // it is unbroken. A packet after a gap (one lost on the way) waits in
+  // `ahead` until the device resends the missing one and the chain joins up.
+  // Returns the samples not received before.
+  receive(prevSeq, samples) {
+    const seen = (seq) => seq <= this.acked || this.ahead.some(([prev, last]) => seq > prev && seq <= last);
+    const fresh = samples.filter((s) => !seen(s.seq));
+    if (!samples.length) return fresh;
+
+    const last = samples[samples.length - 1].seq;
+    if (prevSeq <= this.acked) {
+      this.acked = Math.max(this.acked, last);
+      for (let i; (i = this.ahead.findIndex(([prev]) => prev <= this.acked)) >= 0; ) {
+        this.acked = Math.max(this.acked, this.ahead[i][1]);
+        this.ahead.splice(i, 1);
+      }
+    } else if (this.ahead.length < MAX_AHEAD) {
+      this.ahead.push([prevSeq, last]);
+    }
+    return fresh;
+  }
+
+  // What dashboards get about a sensor
+  toJSON() {
+    return {
+      sensorId: this.id,
+      zone: this.zone,
+      presence: this.presence,
+      lastRaw: this.lastRaw,
+      lastUpdate: this.lastUpdate,
+      targets: this.targets,
+      stats: {
+        samples: this.samples,
+        changes: this.changes,
+        replayed: this.replayed,
+        lastSeen: this.lastSeen && new Date(this.lastSeen).toISOString(),
+      },
+    };
+  }
+}
+
+export class SensorRegistry {
+  // `zones` maps sensorId -> zone. `onFlip(sensor, at)` is called for every
+  // presence change, with the time (ms) it really happened: for a held-off
+  // vacancy, the first reading without anyone. `onDebounced(sensor)` is
+  // called when such a vacancy takes effect, outside of any reading.
+  constructor({ zones = new Map(), onFlip = () => {}, onDebounced = () => {} } = {}) {
+    this.sensors = new Map();
+    this.zones = zones;
+    this.occupied = 0;
+    this.lastRaw = "";
+    this.lastUpdate = null;
+    this.onFlip = onFlip;
+    this.onDebounced = onDebounced;
+  }
+
+  // Without creating it
+  find(id) {
+    return this.sensors.get(id);
+  }
+
+  get(id) {
+    let sensor = this.sensors.get(id);
+    if (!sensor) {
+      sensor = new Sensor(id, this.zones.get(id) ?? null);
+      this.sensors.set(id, sensor);
+    }
+    return sensor;
+  }
+
+  get presence() {
+    return this.occupied > 0;
+  }
+
+  // Files one live reading; returns true if the sensor's presence flipped
+  update(sensor, raw, presence, targets) {
+    sensor.lastRaw = this.lastRaw = raw;
+    sensor.targets = targets;
+    sensor.lastSeen = Date.now();
+    sensor.samples++;
+    return this.debounce(sensor, presence, sensor.lastSeen);
+  }
+
+  // Files one replayed reading taken at `at` (wall time). Only what is newer
+  // than the sensor's last reading counts: the backlog moves presence and
+  // history forward, never back. Returns true if presence flipped.
+  replay(sensor, presence, at) {
+    if (sensor.lastSeen !== null && at < sensor.lastSeen) return false;
+    sensor.lastSeen = at;
+    return this.debounce(sensor, presence, at);
+  }
+
+  debounce(sensor, presence, at) {
+    // A reading HOLD_MS after the vacancy started, whatever it sees, means
+    // nobody was there in between (a replay runs faster than the timer)
+    let flipped = false;
+    if (sensor.vacantSince !== null && at - sensor.vacantSince >= HOLD_MS) {
+      this.vacate(sensor);
+      flipped = true;
+    }
+    if (presence) {
+      if (sensor.vacantSince !== null) {
+        clearTimeout(sensor.vacantTimer);
+        sensor.vacantSince = sensor.vacantTimer = null;
+      }
+      if (!sensor.presence) {
+        this.flip(sensor, true, at);
+        flipped = true;
+      }
+    } else if (sensor.presence && sensor.vacantSince === null) {
+      if (HOLD_MS <= 0) {
+        this.flip(sensor, false, at);
+        return true;
+      }
+      sensor.vacantSince = at;
+      sensor.vacantTimer = setTimeout(() => {
+        this.vacate(sensor);
+        this.onDebounced(sensor);
+      }, HOLD_MS);
+    }
+    return flipped;
+  }
+
+  vacate(sensor) {
+    const since = sensor.vacantSince;
+    clearTimeout(sensor.vacantTimer);
+    sensor.vacantSince = sensor.vacantTimer = null;
+    this.flip(sensor, false, since);
+  }
+
+  flip(sensor, presence, at) {
+    sensor.presence = presence;
+    sensor.lastUpdate = this.lastUpdate = new Date().toISOString();
+    sensor.changes++;
+    this.occupied += presence ? 1 : -1;
+    this.onFlip(sensor, at);
+  }
+
+  values() {
+    return this.sensors.values();
+  }
+}
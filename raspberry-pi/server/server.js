@@ -1,116 +1,435 @@
 import express from "express";
 import { WebSocketServer, WebSocket } from "ws";
+import fs from "fs";
 import http from "http";
 import path from "path";
+import { monitorEventLoopDelay } from "perf_hooks";
 import { fileURLToPath } from "url";
+import { decodeTelemetry, sampleToRaw } from "./telemetry.js";
+import { CLOCK_PROBES, ClockSync, LatencyTracker, isTraced, now } from "./latency.js";
+import { PresenceParser, derivePresence, parseJsonObject } from "./presence.js";
+import { SensorRegistry } from "./sensors.js";
+import { Publisher } from "./publish.js";
+import { HistoryStore, MAX_POINTS, RESOLUTIONS } from "./history.js";
 
 const PORT = 3000;
 const WS_PATH = "/ws";
-
-// In-memory state
-let presence = false;
-let lastRaw = "";
-let lastUpdate = null;
-
-// Derive presence from a raw line (adjust to your sensor output)
-function derivePresence(raw) {
-    const line = raw.trim();
-    if (!line) return false;
-    // Try JSON with numeric target fields
-    try {
-      const obj = JSON.parse(line);
-      for (const k of ["targets","targetCount","count"]) {
-        if (typeof obj[k] === "number") return obj[k] > 0;
-      }
-      if (typeof obj.presence === "boolean") return obj.presence;
-      if (typeof obj.occupied === "boolean") return obj.occupied;
-    } catch {}
-    // key=value pattern: targets=1
-    const kv = line.match(/\b(targets?|count)\s*=\s*(\d+)/i);
-    if (kv) return parseInt(kv[2],10) > 0;
-    // simple CSV: second field numeric count
-    const parts = line.split(/[,;]/).map(p=>p.trim());
-    if (parts.length >= 2 && /^\d+$/.test(parts[1])) return parseInt(parts[1],10) > 0;
-    // fallback keywords
-    return /\b(person|human|occupied|presence|target)\b/i.test(line);
-  }
-
-const app = express();
+// Messages to sensors are compressed from this size on (see the WebSocket
+// servers below); acks and heartbeats stay below it.
+const DEFLATE_THRESHOLD = Number(process.env.WS_DEFLATE_THRESHOLD ?? 1024);
 
 // Use absolute path for static files (public next to server.js)
 const __filename = fileURLToPath(import.meta.url);
 const __dirname = path.dirname(__filename);
+
+// Optional zones.json next to server.js: { "<zone>": ["<sensorId>", ...] }.
+// Dashboards can subscribe to a zone instead of listing its sensors.
+function loadZones(file) {
+  const zones = new Map();
+  if (!fs.existsSync(file)) return zones;
+  for (const [zone, ids] of Object.entries(JSON.parse(fs.readFileSync(file, "utf8")))) {
+    for (const id of ids) zones.set(String(id), zone);
+  }
+  console.log("Loaded", zones.size, "sensor zones from", file);
+  return zones;
+}
+
+// Occupancy history on disk, see history.js
+const history = new HistoryStore(process.env.HISTORY_DIR ?? path.join(__dirname, "data", "history"));
+setInterval(() => history.flush(), 60 * 1000);
+
+// In-memory state, one entry per sensorId. Vacancies that only take effect
+// after the debounce hold are announced from the timer.
+const sensors = new SensorRegistry({
+  zones: loadZones(process.env.ZONES_FILE ?? path.join(__dirname, "zones.json")),
+  onFlip: (sensor, at) => history.record(sensor.id, at, sensor.presence),
+  onDebounced: (sensor) => {
+    broadcastState(sensor);
+    console.log("Presence changed:", sensor.presence, "sensor:", sensor.id);
+  },
+});
+
+function stateMessage(sensor, trace) {
+  return {
+    type: "state", sensorId: sensor.id, presence: sensor.presence, lastRaw: sensor.lastRaw,
+    lastUpdate: sensor.lastUpdate, targets: sensor.targets, ...trace,
+  };
+}
+
+// Dashboards subscribed to a sensor get one message per reading of it
+const publisher = new Publisher((sensorId) => {
+  const sensor = sensors.find(sensorId);
+  return sensor && stateMessage(sensor);
+});
+
+function broadcastState(sensor, trace) {
+  publisher.publish("state", sensor.id, sensor.zone, stateMessage(sensor, trace));
+}
+
+// Record one reading and tell the dashboards; returns true if presence flipped.
+// `trace` ({ seq, traced }) rides along; dashboards report their timing
+// for the traced ones.
+function applyReading(sensorId, raw, newPresence, targets, trace) {
+  const sensor = sensors.get(sensorId);
+  if (sensors.update(sensor, raw, newPresence, targets)) {
+    broadcastState(sensor, trace);
+    return true;
+  }
+  publisher.publish("raw", sensorId, sensor.zone, { type: "raw", sensorId, raw, targets, timestamp: new Date().toISOString(), ...trace });
+  return false;
+}
+
+// Per-hop latency of live samples, see latency.js
+const latency = new LatencyTracker();
+
+function sendHeartbeat(ws, probes = CLOCK_PROBES) {
+  if (ws.readyState !== WebSocket.OPEN) return;
+  ws.probesLeft = probes - 1;
+  ws.send(JSON.stringify({ type: "heartbeat", ts: Date.now(), mono: now() }));
+}
+
+// Clock replies and trace reports; returns true if `obj` was one
+function handleLatencyMessage(ws, obj) {
+  if (obj.type === "clock") {
+    // ESP32s answer in 32-bit micros() and name themselves, browsers in ms
+    ws.clock ??= obj.sensorId ? new ClockSync(0.001, 32) : new ClockSync();
+    ws.clock.update(obj.t1, obj.t2, obj.t3, now());
+    // Rest of the burst, one probe per reply
+    if (ws.probesLeft > 0) setTimeout(() => sendHeartbeat(ws, ws.probesLeft), 20);
+    return true;
+  }
+  if (obj.type === "trace") {
+    ws.clock ??= obj.samples ? new ClockSync(0.001, 32) : new ClockSync();
+    if (obj.samples) latency.device(obj.sensorId, ws.clock, obj);
+    else latency.browser(ws.clock, obj);
+    return true;
+  }
+  return false;
+}
+
+// Live sample: derive, broadcast and, if it is traced, time both steps
+function applySample(sensorId, sample, rx) {
+  const raw = sampleToRaw(sample);
+  const newPresence = sample.targets.length > 0;
+  const derived = now();
+  const traced = isTraced(sample.seq);
+  const changed = applyReading(sensorId, raw, newPresence, sample.targets, traced ? { seq: sample.seq, traced } : { seq: sample.seq });
+  if (traced) latency.server(sensorId, sample.seq, rx, derived, now());
+  return changed;
+}
+
+// Store-and-forward: the ESP32 keeps every sample until it is acked by seq
+// and replays its backlog after an outage. The ack only goes as far as the
+// samples received without a gap (Sensor.receive), so a packet lost on the
+// way is sent again rather than trimmed from the device's log. Returns the
+// samples not received before.
+function ackSamples(ws, sensorId, prevSeq, samples) {
+  const sensor = sensors.get(sensorId);
+  const fresh = sensor.receive(prevSeq, samples);
+  if (ws.readyState === WebSocket.OPEN) ws.send(JSON.stringify({ type: "ack", sensorId, seq: sensor.acked }));
+  return fresh;
+}
+
+// Backlog is debounced and filed in the history at the time it was taken
+// (Sensor.wallTime); samples from a boot the server never heard of are
+// acked but not filed. Dashboards are told to reload what they show of
+// the history.
+function applyReplay(sensorId, fresh) {
+  const sensor = sensors.get(sensorId);
+  if (!fresh.length) return;
+  sensor.replayed += fresh.length;
+  let filed = 0;
+  let changed = false;
+  for (const sample of fresh) {
+    const at = sensor.wallTime(sample.seq, sample.ts);
+    if (at === null) continue;
+    filed++;
+    if (sensors.replay(sensor, sample.targets.length > 0, at)) changed = true;
+  }
+  if (changed) broadcastState(sensor);
+  if (filed) publisher.publish("event", sensorId, sensor.zone, { type: "history", sensorId, samples: filed });
+  console.log("Replayed", fresh.length, "samples from", sensorId, "up to seq", fresh[fresh.length - 1].seq, "filed", filed);
+}
+
+// JSON fallback of the binary telemetry: targets as [x, y, speed, distance]
+function targetsFromJson(list) {
+  return list.map(([x, y, speed, distance]) => ({ x, y, speed, distance }));
+}
+
+// A connection that sends readings is a sensor; it stops getting dashboard
+// traffic, only its acks and heartbeats
+function identifySensor(ws, sensorId) {
+  if (!ws.sensorId) publisher.remove(ws);
+  ws.sensorId = sensorId;
+}
+
+const app = express();
 app.use(express.static(path.join(__dirname, "public")));
 
-// REST endpoint for polling
+// REST endpoint for polling: floor-wide presence (anyone seen by any sensor)
+// plus every sensor's own state and counters
 app.get("/api/state", (_req, res) => {
-  res.json({ presence, lastRaw, lastUpdate });
+  const { presence, lastRaw, lastUpdate } = sensors;
+  res.json({ presence, lastRaw, lastUpdate, sensors: [...sensors.values()] });
+});
+
+app.get("/api/sensors/:id", (req, res) => {
+  const sensor = sensors.find(req.params.id);
+  if (!sensor) return res.status(404).json({ error: "unknown sensor" });
+  res.json(sensor);
+});
+
+// p50/p95/p99/max per hop over the latest samples, plus each peer's clock sync
+app.get("/api/latency", (_req, res) => {
+  const clocks = [];
+  for (const client of peers()) {
+    if (client.clock?.synced) clocks.push({ peer: client.peer, rttMs: Math.round(client.clock.rtt * 1000) / 1000 });
+  }
+  res.json({ hops: latency.stats(), clocks });
+});
+
+// ?from=&to= as ms since the epoch or ISO dates; the last 24 h by default
+function timeRange(query) {
+  const parse = (v, fallback) => {
+    if (v === undefined) return fallback;
+    const t = /^\d+$/.test(v) ? Number(v) : Date.parse(v);
+    return Number.isFinite(t) ? t : NaN;
+  };
+  const to = parse(query.to, Date.now());
+  const from = parse(query.from, to - 24 * 60 * 60 * 1000);
+  return Number.isNaN(from) || Number.isNaN(to) || from >= to ? null : { from, to };
+}
+
+// Occupied ms per bucket: { from, step, occupied: [...] }. ?step=1m|15m|1h,
+// by default the finest that keeps it under MAX_POINTS points. The range is
+// cut to the sensor's history, from its first hour up to now.
+app.get("/api/history/:id", (req, res) => {
+  const range = timeRange(req.query);
+  if (!range) return res.status(400).json({ error: "bad from/to" });
+  const step = req.query.step;
+  if (step !== undefined && !(step in RESOLUTIONS)) return res.status(400).json({ error: "step is one of " + Object.keys(RESOLUTIONS) });
+  const bounds = history.bounds(req.params.id, range.from, range.to);
+  if (!bounds) return res.status(404).json({ error: "no history for sensor" });
+  if (step !== undefined && (bounds.to - bounds.from) / RESOLUTIONS[step].step > MAX_POINTS) {
+    return res.status(400).json({ error: `more than ${MAX_POINTS} points at step ${step}` });
+  }
+  res.json({ sensorId: req.params.id, ...history.series(req.params.id, bounds.from, bounds.to, step) });
+});
+
+// Presence changes: { events: [[t, presence], ...] }
+app.get("/api/history/:id/events", (req, res) => {
+  const range = timeRange(req.query);
+  if (!range) return res.status(400).json({ error: "bad from/to" });
+  const events = history.events(req.params.id, range.from, range.to);
+  if (!events) return res.status(404).json({ error: "no history for sensor" });
+  res.json({ sensorId: req.params.id, events });
+});
+
+// Share of [from, to) each sensor saw someone, for utilization reports
+app.get("/api/utilization", (req, res) => {
+  const range = timeRange(req.query);
+  if (!range) return res.status(400).json({ error: "bad from/to" });
+  const span = range.to - range.from;
+  const sensorsOut = history.ids().map((id) => {
+    const occupiedMs = history.total(id, range.from, range.to);
+    return { sensorId: id, occupiedMs, utilization: Math.round((occupiedMs / span) * 1e4) / 1e4 };
+  });
+  res.json({ ...range, sensors: sensorsOut });
+});
+
+// Process health for load tests (load-test.js): CPU time and memory so far,
+// event loop delay since the previous call, and samples filed
+const LOOP_RESOLUTION_MS = 10;
+const loopDelay = monitorEventLoopDelay({ resolution: LOOP_RESOLUTION_MS });
+loopDelay.enable();
+app.get("/api/metrics", (_req, res) => {
+  let samples = 0;
+  for (const sensor of sensors.values()) samples += sensor.samples;
+  const { rss, heapUsed } = process.memoryUsage();
+  // The histogram includes the sampling interval itself
+  const ms = (ns) => Math.max(0, Math.round(ns / 1e4 - LOOP_RESOLUTION_MS * 100) / 100);
+  res.json({
+    uptime: process.uptime(),
+    cpu: process.cpuUsage(),
+    rss,
+    heapUsed,
+    loopDelay: { p50: ms(loopDelay.percentile(50)), p99: ms(loopDelay.percentile(99)), max: ms(loopDelay.max) },
+    sensors: sensors.sensors.size,
+    clients: sensorWss.clients.size + dashboardWss.clients.size,
+    samples,
+  });
+  loopDelay.reset();
+});
+
+// Dashboards: what each is subscribed to and how its delivery is going
+app.get("/api/clients", (_req, res) => {
+  res.json(publisher.stats());
 });
 
 const server = http.createServer(app);
 
-// WebSocket server
-const wss = new WebSocketServer({ server, path: WS_PATH });
+// Connect query keys that mark a peer as a dashboard
+const SUBSCRIBE_PARAMS = ["sensors", "zones", "rate"];
 
-// Broadcast helper
-function broadcast(obj) {
-  const msg = JSON.stringify(obj);
-  for (const client of wss.clients) {
-    if (client.readyState === WebSocket.OPEN) client.send(msg);
+// Two WebSocket servers on WS_PATH, picked by the connect URL. Sensors
+// compress their telemetry (WEBSOCKETS_DEFLATE_WINDOW_BITS); permessage-deflate
+// takes whatever window they offer, as a serverMaxWindowBits above it would
+// refuse the offer. Without context takeover on the server's side ws
+// honours the threshold, so acks and heartbeats go out as they are.
+// Dashboards get no deflate: what they are sent is serialized once for all
+// of them (publish.js) and would otherwise be compressed again per socket,
+// with a zlib context each.
+const sensorWss = new WebSocketServer({
+  noServer: true,
+  perMessageDeflate: { threshold: DEFLATE_THRESHOLD, serverNoContextTakeover: true },
+});
+const dashboardWss = new WebSocketServer({ noServer: true, perMessageDeflate: false });
+
+server.on("upgrade", (req, socket, head) => {
+  const url = new URL(req.url, "http://localhost");
+  if (url.pathname !== WS_PATH) {
+    socket.destroy();
+    return;
   }
+  const wss = SUBSCRIBE_PARAMS.some((key) => url.searchParams.has(key)) ? dashboardWss : sensorWss;
+  wss.handleUpgrade(req, socket, head, (ws) => wss.emit("connection", ws, req));
+});
+
+function* peers() {
+  yield* sensorWss.clients;
+  yield* dashboardWss.clients;
 }
 
-wss.on("connection", (ws, req) => {
+// Current state of every sensor the dashboard is subscribed to
+function sendSnapshot(ws) {
+  const list = [];
+  for (const sensor of sensors.values()) {
+    if (publisher.wants(ws, sensor.id, sensor.zone)) list.push(sensor);
+  }
+  ws.send(JSON.stringify({ type: "sensors", sensors: list }));
+}
+
+function onConnection(ws, req) {
   console.log("WS client connected:", req.socket.remoteAddress);
-  ws.send(JSON.stringify({ type: "state", presence, lastRaw, lastUpdate }));
+  ws.peer = req.socket.remoteAddress + ":" + req.socket.remotePort;
+  ws.parser = new PresenceParser();
+  // Readings without a sensorId are filed under the sender's address
+  ws.sensorId = null;
+  // Sensors only ever get acks and heartbeats. A peer becomes a dashboard
+  // with a subscription in its connect URL (/ws?rate=10) or a subscribe
+  // message, and only then gets the snapshot, which grows with the registry.
+  const query = new URL(req.url, "http://localhost").searchParams;
+  if (SUBSCRIBE_PARAMS.some((key) => query.has(key))) {
+    publisher.add(ws, ws.peer, query);
+    sendSnapshot(ws);
+  }
+  // First clock sample right away instead of at the next heartbeat
+  sendHeartbeat(ws);
+
+  ws.on("message", (data, isBinary) => {
+    const rx = now();
+    if (isBinary) {
+      const packet = decodeTelemetry(data);
+      if (!packet) {
+        console.warn("Dropped malformed telemetry from", req.socket.remoteAddress);
+        return;
+      }
+      identifySensor(ws, packet.sensorId);
+      const fresh = ackSamples(ws, packet.sensorId, packet.prevSeq, packet.samples);
+      if (packet.replay) {
+        applyReplay(packet.sensorId, fresh);
+        return;
+      }
+      for (const sample of fresh) {
+        if (applySample(packet.sensorId, sample, rx)) {
+          console.log("Presence changed:", sample.targets.length > 0, "sensor:", packet.sensorId, "raw:", sensors.lastRaw);
+        }
+      }
+      return;
+    }
 
-  ws.on("message", data => {
     let rawLine = data.toString();
-try {
-  const obj = JSON.parse(rawLine);
-  if (obj && typeof obj === "object" && "raw" in obj) rawLine = String(obj.raw);
-} catch {}
+    let targets;
+    // The sensor's own line as JSON, if it was not wrapped by the ESP32
+    let parsed;
+    const obj = parseJsonObject(rawLine);
+    if (obj) {
+      if (handleLatencyMessage(ws, obj)) return;
+      if (obj.type === "hello") {
+        identifySensor(ws, String(obj.sensorId));
+        sensors.get(ws.sensorId).hello(obj.boot, obj.prevBoot, obj.uptime, Date.now());
+        return;
+      }
+      if (obj.type === "subscribe") {
+        if (!publisher.has(ws)) publisher.add(ws, ws.peer);
+        publisher.subscribe(ws, obj);
+        sendSnapshot(ws);
+        return;
+      }
+      identifySensor(ws, typeof obj.sensorId === "string" ? obj.sensorId : ws.sensorId ?? req.socket.remoteAddress);
+      if ("raw" in obj) rawLine = String(obj.raw);
+      else if (Array.isArray(obj.targets)) {
+        targets = targetsFromJson(obj.targets);
+        if (typeof obj.seq === "number") {
+          const [fresh] = ackSamples(ws, ws.sensorId, obj.prev ?? 0, [{ seq: obj.seq }]);
+          if (fresh && applySample(ws.sensorId, { seq: obj.seq, targets }, rx)) {
+            console.log("Presence changed:", targets.length > 0, "sensor:", ws.sensorId, "raw:", sensors.lastRaw);
+          }
+          return;
+        }
+        rawLine = sampleToRaw({ targets });
+      } else parsed = obj;
+    }
 
     const raw = rawLine.trim();
     if (!raw) return;
+    if (!ws.sensorId) identifySensor(ws, req.socket.remoteAddress);
 
-    lastRaw = raw;
-    const newPresence = derivePresence(raw);
-    if (newPresence !== presence) {
-      presence = newPresence;
-      lastUpdate = new Date().toISOString();
-      broadcast({ type: "state", presence, lastRaw, lastUpdate });
-      console.log("Presence changed:", presence, "raw:", raw);
-    } else {
-      // Optional: comment out if too chatty
-      broadcast({ type: "raw", raw, timestamp: new Date().toISOString() });
+    let newPresence;
+    if (targets) newPresence = targets.length > 0;
+    else {
+      const format = ws.parser.format;
+      newPresence = ws.parser.parse(raw, parsed);
+      if (ws.parser.format !== format) console.log("Sensor format:", ws.parser.format, "from", ws.peer);
+    }
+    if (applyReading(ws.sensorId, raw, newPresence, targets)) {
+      console.log("Presence changed:", newPresence, "sensor:", ws.sensorId, "raw:", raw);
     }
   });
 
-  ws.on("close", () => console.log("WS client disconnected"));
-});
+  ws.on("close", () => {
+    publisher.remove(ws);
+    console.log("WS client disconnected");
+  });
+}
+
+sensorWss.on("connection", onConnection);
+dashboardWss.on("connection", onConnection);
 
-// Optional heartbeat to keep connections alive
+// Heartbeat keeps connections alive; the replies keep every peer's clock
+// offset fresh for the latency trace
 setInterval(() => {
-  broadcast({ type: "heartbeat", ts: Date.now() });
+  for (const client of peers()) sendHeartbeat(client);
 }, 15000);
 
 app.post("/api/inject", express.json(), (req, res) => {
     const rawLine = String(req.body.raw || "");
     if (!rawLine.trim()) return res.status(400).json({ error: "raw required" });
     // Reuse presence logic
-    lastRaw = rawLine.trim();
-    const newPresence = derivePresence(lastRaw);
-    if (newPresence !== presence) {
-      presence = newPresence;
-      lastUpdate = new Date().toISOString();
-      broadcast({ type: "state", presence, lastRaw, lastUpdate });
-    } else {
-      broadcast({ type: "raw", raw: lastRaw, timestamp: new Date().toISOString() });
-    }
-    res.json({ ok: true, presence });
+    const raw = rawLine.trim();
+    const sensorId = String(req.body.sensorId || "inject");
+    applyReading(sensorId, raw, derivePresence(raw));
+    res.json({ ok: true, sensorId, presence: sensors.get(sensorId).presence });
   });
 
+// Occupied time up to now goes to disk before exiting
+for (const signal of ["SIGINT", "SIGTERM"]) {
+  process.on(signal, () => {
+    history.close();
+    process.exit(0);
+  });
+}
+
 server.listen(PORT, () => {
   console.log(`HTTP+WS server listening on :${PORT} (path ${WS_PATH})`);
 });
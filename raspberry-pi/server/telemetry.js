@@ -0,0 +1,93 @@
+// Decoder for the binary presence telemetry sent by the ESP32 with sendBIN().
+// Layout is documented in esp32/src/telemetry.h; keep both in sync.
+//
+//   packet: u8 magic | u8 version | u8 flags | u8 idLen | id | u32 prevSeq | u8 sampleCount | samples
+//   sample: u32 seq | u32 ts | u8 targetCount | targetCount x (i16 x, i16 y, i16 speed, u16 distance)
+
+export const TELEMETRY_MAGIC = 0xa5;
+export const TELEMETRY_VERSION = 2;
+export const TELEMETRY_FLAG_REPLAY = 0x01;
+
+const SAMPLE_HEADER_SIZE = 9;
+const TARGET_SIZE = 8;
+
+// Returns { sensorId, version, flags, replay, prevSeq, samples: [{ seq, ts, targets: [{ x, y, speed, distance }] }] }
+// or null if the buffer is not a well-formed telemetry packet. `replay` marks
+// backlog from the ESP32's offline log rather than live readings; `prevSeq`
+// is the seq of the sample before the first one in that log (0: none left).
+export function decodeTelemetry(buf) {
+  if (!Buffer.isBuffer(buf) || buf.length < 9) return null;
+  if (buf[0] !== TELEMETRY_MAGIC || buf[1] !== TELEMETRY_VERSION) return null;
+
+  const idLen = buf[3];
+  let off = 4 + idLen;
+  if (buf.length < off + 5) return null;
+  const sensorId = buf.toString("latin1", 4, off);
+  const prevSeq = buf.readUInt32LE(off);
+  off += 4;
+  const sampleCount = buf[off++];
+
+  const samples = new Array(sampleCount);
+  for (let i = 0; i < sampleCount; i++) {
+    if (buf.length < off + SAMPLE_HEADER_SIZE) return null;
+    const seq = buf.readUInt32LE(off);
+    const ts = buf.readUInt32LE(off + 4);
+    const count = buf[off + 8];
+    off += SAMPLE_HEADER_SIZE;
+
+    if (buf.length < off + count * TARGET_SIZE) return null;
+    const targets = new Array(count);
+    for (let t = 0; t < count; t++) {
+      targets[t] = {
+        x: buf.readInt16LE(off),
+        y: buf.readInt16LE(off + 2),
+        speed: buf.readInt16LE(off + 4),
+        distance: buf.readUInt16LE(off + 6),
+      };
+      off += TARGET_SIZE;
+    }
+    samples[i] = { seq, ts, targets };
+  }
+
+  const flags = buf[2];
+  return { sensorId, version: buf[1], flags, replay: (flags & TELEMETRY_FLAG_REPLAY) !== 0, prevSeq, samples };
+}
+
+// Inverse of decodeTelemetry(), as the ESP32's SampleBatcher builds packets;
+// used by load-test.js to stand in for real boards
+export function encodeTelemetry(sensorId, samples, flags = 0, prevSeq = 0) {
+  const id = Buffer.from(sensorId, "latin1");
+  let size = 9 + id.length;
+  for (const s of samples) size += SAMPLE_HEADER_SIZE + s.targets.length * TARGET_SIZE;
+
+  const buf = Buffer.alloc(size);
+  buf[0] = TELEMETRY_MAGIC;
+  buf[1] = TELEMETRY_VERSION;
+  buf[2] = flags;
+  buf[3] = id.length;
+  id.copy(buf, 4);
+  let off = 4 + id.length;
+  buf.writeUInt32LE(prevSeq >>> 0, off);
+  off += 4;
+  buf[off++] = samples.length;
+  for (const s of samples) {
+    buf.writeUInt32LE(s.seq >>> 0, off);
+    buf.writeUInt32LE(s.ts >>> 0, off + 4);
+    buf[off + 8] = s.targets.length;
+    off += SAMPLE_HEADER_SIZE;
+    for (const t of s.targets) {
+      buf.writeInt16LE(t.x, off);
+      buf.writeInt16LE(t.y, off + 2);
+      buf.writeInt16LE(t.speed, off + 4);
+      buf.writeUInt16LE(t.distance, off + 6);
+      off += TARGET_SIZE;
+    }
+  }
+  return buf;
+}
+
+// Text form of a decoded sample, used wherever a raw line used to go
+// (dashboard log, /api/state lastRaw). derivePresence() understands it.
+export function sampleToRaw(sample) {
+  return "targets=" + sample.targets.length;
+}
@@ -63,29 +63,281 @@
 
 
 const statusEl = document.getElementById("status");
-const desks = [
-    document.getElementById("desk1"), 
-    document.getElementById("desk2"), 
-    document.getElementById("desk3")
-];
+const canvas = document.getElementById("floorplan");
+const ctx2d = canvas.getContext("2d");
 const logEl = document.getElementById("log");
 
-function applyPresence(present, raw) {
-    desks[0].classList.toggle("occupied", present);
-    desks[0].classList.toggle("vacant", !present);
-    statusEl.textContent = present ? "Presence detected" : "No presence";
-    if (raw) appendLog("STATE raw=" + raw);
+// Floorplan: desks come from floorplan.json,
+//   { width, height, desks: [{ label, sensor, x, y, w, h }] }
+// A desk without a sensor goes to the first unmapped sensor that reports;
+// sensors left over get a desk on a grid below the plan. All desks are
+// drawn on one canvas: a state change only marks its desk dirty, and the
+// dirty desks are repainted together in the next animation frame, however
+// many messages came in between.
+const DESK_W = 80;
+const DESK_H = 60;
+const DESK_COLORS = {
+    occupied: ["#ff6961", "#fff"],
+    vacant: ["#77dd77", "#000"],
+    unassigned: ["#bbb", "#000"],
+};
+const FLOOR_COLOR = "#f2f2f2";
+
+const plan = { width: 400, height: 250, desks: [], gridTop: 20 };
+const deskBySensor = new Map();     // sensorId -> desk
+const freeDesks = [];               // desks waiting for a sensor
+const dirtyDesks = new Set();
+let gridCount = 0;                  // desks placed on the fallback grid
+let fullRedraw = true;
+let planFrame = 0;
+let occupiedCount = 0;
+let statusDirty = false;
+
+async function loadPlan() {
+    try {
+        const res = await fetch("floorplan.json");
+        if (res.ok) Object.assign(plan, await res.json());
+    } catch (e) {
+        appendLog("No floorplan.json, desks go on a grid: " + e);
+    }
+    plan.desks = plan.desks.map(d => ({
+        label: d.label ?? d.sensor ?? "", sensor: d.sensor ?? null,
+        x: d.x, y: d.y, w: d.w ?? DESK_W, h: d.h ?? DESK_H, present: false, util: ""
+    }));
+    for (const desk of plan.desks) {
+        if (desk.sensor) deskBySensor.set(desk.sensor, desk);
+        else freeDesks.push(desk);
+    }
+    plan.gridTop = plan.desks.reduce((bottom, d) => Math.max(bottom, d.y + d.h), 0) + 20;
+    fullRedraw = true;
+    schedulePlanRender();
+}
+
+function deskFor(sensorId) {
+    let desk = deskBySensor.get(sensorId);
+    if (desk) return desk;
+    desk = freeDesks.shift();
+    if (desk) {
+        desk.label = sensorId;
+    } else {
+        // As wide as the window allows, so a building's worth stays compact
+        const width = Math.max(plan.width, (window.innerWidth || 0) - 40);
+        const columns = Math.max(1, Math.floor((width - 20) / (DESK_W + 40)));
+        desk = {
+            label: sensorId,
+            x: 20 + (gridCount % columns) * (DESK_W + 40),
+            y: plan.gridTop + Math.floor(gridCount / columns) * (DESK_H + 20),
+            w: DESK_W, h: DESK_H, present: false, util: ""
+        };
+        gridCount++;
+        plan.desks.push(desk);
+        if (desk.x + desk.w + 20 > plan.width || desk.y + desk.h + 20 > plan.height) {
+            plan.width = Math.max(plan.width, desk.x + desk.w + 20);
+            plan.height = Math.max(plan.height, desk.y + desk.h + 20);
+            fullRedraw = true;
+        }
+    }
+    desk.sensor = sensorId;
+    deskBySensor.set(sensorId, desk);
+    markDirty(desk);
+    return desk;
+}
+
+function markDirty(desk) {
+    dirtyDesks.add(desk);
+    schedulePlanRender();
+}
+
+function schedulePlanRender() {
+    if (!planFrame) planFrame = requestAnimationFrame(renderPlan);
+}
+
+function renderPlan() {
+    planFrame = 0;
+    if (fullRedraw) {
+        const dpr = window.devicePixelRatio || 1;
+        canvas.width = plan.width * dpr;
+        canvas.height = plan.height * dpr;
+        canvas.style.width = plan.width + "px";
+        canvas.style.height = plan.height + "px";
+        ctx2d.setTransform(dpr, 0, 0, dpr, 0, 0);
+        ctx2d.fillStyle = FLOOR_COLOR;
+        ctx2d.fillRect(0, 0, plan.width, plan.height);
+        for (const desk of plan.desks) drawDesk(desk);
+        fullRedraw = false;
+    } else {
+        for (const desk of dirtyDesks) drawDesk(desk);
+    }
+    dirtyDesks.clear();
+
+    if (statusDirty) {
+        statusEl.textContent = occupiedCount
+            ? "Presence detected (" + occupiedCount + " of " + deskBySensor.size + " sensors)"
+            : "No presence";
+        statusDirty = false;
+    }
+}
+
+function drawDesk(desk) {
+    const [fill, text] = DESK_COLORS[!desk.sensor ? "unassigned" : desk.present ? "occupied" : "vacant"];
+    ctx2d.fillStyle = FLOOR_COLOR;
+    ctx2d.fillRect(desk.x - 1, desk.y - 1, desk.w + 2, desk.h + 2);
+    ctx2d.fillStyle = fill;
+    ctx2d.beginPath();
+    ctx2d.roundRect(desk.x, desk.y, desk.w, desk.h, 4);
+    ctx2d.fill();
+
+    ctx2d.fillStyle = text;
+    ctx2d.textAlign = "center";
+    ctx2d.textBaseline = "middle";
+    const cx = desk.x + desk.w / 2;
+    const cy = desk.y + desk.h / 2;
+    ctx2d.font = "12px sans-serif";
+    ctx2d.fillText(desk.label, cx, desk.util ? cy - 7 : cy, desk.w - 6);
+    if (desk.util) {
+        ctx2d.font = "10px sans-serif";
+        ctx2d.fillText(desk.util, cx, cy + 8, desk.w - 6);
+    }
+}
+
+// Desk under the pointer, for the tooltip
+canvas.addEventListener("mousemove", evt => {
+    const rect = canvas.getBoundingClientRect();
+    const x = evt.clientX - rect.left;
+    const y = evt.clientY - rect.top;
+    const desk = plan.desks.find(d => x >= d.x && x < d.x + d.w && y >= d.y && y < d.y + d.h);
+    if (!desk) {
+        canvas.title = "";
+        return;
+    }
+    const sensor = desk.sensor !== desk.label ? desk.sensor : null;
+    canvas.title = [desk.label, sensor, desk.util].filter(Boolean).join(" · ");
+});
+
+function applyPresence(sensorId, present, raw) {
+    const desk = deskFor(sensorId);
+    if (desk.present !== present) {
+        occupiedCount += present ? 1 : -1;
+        desk.present = present;
+        markDirty(desk);
+    }
+    statusDirty = true;
+    if (raw) appendLog("STATE " + sensorId + " raw=" + raw);
+}
+
+// Share of today each desk was occupied, from the server's history store
+async function refreshUtilization() {
+    const midnight = new Date();
+    midnight.setHours(0, 0, 0, 0);
+    try {
+        const res = await fetch("/api/utilization?from=" + midnight.getTime());
+        const { sensors } = await res.json();
+        for (const sensor of sensors) {
+            const desk = deskBySensor.get(sensor.sensorId);
+            if (!desk) continue;
+            desk.util = Math.round(sensor.utilization * 100) + "% today";
+            markDirty(desk);
+        }
+    } catch (e) {
+        appendLog("Utilization unavailable: " + e);
+    }
 }
 
+// A replayed backlog arrives in many small packets: one refresh after it
+let utilizationTimer = null;
+function refreshUtilizationSoon() {
+    if (utilizationTimer) return;
+    utilizationTimer = setTimeout(() => {
+        utilizationTimer = null;
+        refreshUtilization();
+    }, 2000);
+}
+
+// Log: the last LOG_CAPACITY lines in a ring buffer, newest first. Only the
+// rows in view exist in the DOM, redrawn at most once per animation frame
+// however many lines arrived in it.
+const LOG_CAPACITY = 1000;
+const LOG_ROW_HEIGHT = 16;          // px, as #log .row in style.css
+const logLines = new Array(LOG_CAPACITY);
+let logHead = 0;                    // next slot to write
+let logCount = 0;
+let logAdded = 0;                   // since the last redraw
+let logFrame = 0;
+const logSpacer = document.createElement("div");
+logEl.appendChild(logSpacer);
+const logRows = [];
+
 function appendLog(line) {
-    const div = document.createElement("div");
-    div.textContent = new Date().toLocaleTimeString() + " " + line;
-    logEl.prepend(div);
+    logLines[logHead] = { time: Date.now(), line };
+    logHead = (logHead + 1) % LOG_CAPACITY;
+    if (logCount < LOG_CAPACITY) logCount++;
+    logAdded++;
+    scheduleLogRender();
+}
+
+function scheduleLogRender() {
+    if (!logFrame) logFrame = requestAnimationFrame(renderLog);
+}
+
+function renderLog() {
+    logFrame = 0;
+    logSpacer.style.height = logCount * LOG_ROW_HEIGHT + "px";
+    // A reader scrolled down to older lines keeps looking at them
+    if (logAdded && logEl.scrollTop > 0) logEl.scrollTop += logAdded * LOG_ROW_HEIGHT;
+    logAdded = 0;
+
+    const first = Math.floor(logEl.scrollTop / LOG_ROW_HEIGHT);
+    const visible = Math.max(0, Math.min(logCount - first, Math.ceil(logEl.clientHeight / LOG_ROW_HEIGHT) + 1));
+    while (logRows.length < visible) {
+        const row = document.createElement("div");
+        row.className = "row";
+        logEl.appendChild(row);
+        logRows.push(row);
+    }
+    for (let i = 0; i < logRows.length; i++) {
+        const row = logRows[i];
+        if (i >= visible) {
+            row.style.display = "none";
+            continue;
+        }
+        const entry = logLines[(logHead - 1 - first - i + 2 * LOG_CAPACITY) % LOG_CAPACITY];
+        row.style.display = "";
+        row.style.transform = "translateY(" + (first + i) * LOG_ROW_HEIGHT + "px)";
+        row.textContent = new Date(entry.time).toLocaleTimeString() + " " + entry.line;
+    }
+}
+
+logEl.addEventListener("scroll", scheduleLogRender, { passive: true });
+
+// Latency trace (see raspberry-pi/server/latency.js): heartbeats are
+// answered with our clock, and for every message the server marked traced
+// (a sample of the seqs) we report when it arrived, when the DOM was
+// updated and when the next frame started.
+function answerHeartbeat(ws, msg, rx) {
+    ws.send(JSON.stringify({ type: "clock", t1: msg.mono, t2: rx, t3: performance.now() }));
+}
+
+function reportTrace(ws, msg, rx) {
+    const dom = performance.now();
+    requestAnimationFrame(() => {
+        if (ws.readyState !== WebSocket.OPEN) return;
+        ws.send(JSON.stringify({
+            type: "trace", sensorId: msg.sensorId, seq: msg.seq, rx, dom, paint: performance.now()
+        }));
+    });
+}
+
+// The page's ?sensors=a,b&zones=east&rate=10 become our subscription; the
+// log does not need raw lines faster than 10/s.
+function subscription() {
+    const params = new URLSearchParams(location.search);
+    if (!params.has("rate")) params.set("rate", "10");
+    return params.toString();
 }
 
 function connectWS() {
     const proto = location.protocol === "https:" ? "wss" : "ws";
-    const url = proto + "://" + location.host + "/ws";
+    const url = proto + "://" + location.host + "/ws?" + subscription();
     const ws = new WebSocket(url);
 
     ws.onopen = () => {
@@ -93,14 +345,27 @@ function connectWS() {
     };
 
     ws.onmessage = evt => {
+        const rx = performance.now();
         const txt = evt.data;
         if (typeof txt === "string" && /^[{\[]/.test(txt.trim())) {
             try {
                 const msg = JSON.parse(txt);
-                if (msg.type === "state") {
-                    applyPresence(msg.presence, msg.lastRaw);
+                if (msg.type === "sensors") {
+                    for (const sensor of msg.sensors) applyPresence(sensor.sensorId, sensor.presence);
+                    refreshUtilization();
+                } else if (msg.type === "state") {
+                    applyPresence(msg.sensorId, msg.presence, msg.lastRaw);
                 } else if (msg.type === "raw") {
-                    appendLog("RAW " + msg.raw);
+                    appendLog("RAW " + msg.sensorId + " " + msg.raw);
+                } else if (msg.type === "history") {
+                    // A sensor's backlog after an outage went into the history
+                    appendLog("REPLAY " + msg.sensorId + " " + msg.samples + " samples");
+                    refreshUtilizationSoon();
+                } else if (msg.type === "heartbeat" && msg.mono !== undefined) {
+                    answerHeartbeat(ws, msg, rx);
+                }
+                if (msg.traced && (msg.type === "state" || msg.type === "raw")) {
+                    reportTrace(ws, msg, rx);
                 }
             } catch (e) {
                 appendLog("JSON parse error " + e);
@@ -116,4 +381,5 @@ function connectWS() {
     };
 }
 
-connectWS();
\ No newline at end of file
+loadPlan().then(connectWS);
+setInterval(refreshUtilization, 60 * 1000);
\ No newline at end of file